@@ -0,0 +1,76 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/17 11:20:37 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/17 11:20:37 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/socket.h>
+#include "AccessLogFormat.hpp"
+
+/**
+ * Per-worker writer of the binary access log (see AccessLogFormat.hpp).
+ * Records are appended to a private buffer without any formatting or locking and
+ * reach the file in one write once the buffer is full or the flush interval passed.
+ * Workers logging to the same path share one file; the lock is only taken to flush
+ * and to rotate the file when it would grow past its size limit.
+ */
+class AccessLog {
+	public:
+		struct Entry
+		{
+			std::chrono::steady_clock::time_point begin;
+			std::string_view method;
+			std::string_view vhost;
+			std::string_view path;
+			int status;
+			uint64_t bytesIn;
+			uint64_t bytesOut;
+			const struct sockaddr_storage* peer;
+		};
+
+		AccessLog();
+		~AccessLog();
+		AccessLog(const AccessLog&) = delete;
+		AccessLog& operator=(const AccessLog&) = delete;
+
+		// rotateKeep is the number of old files kept as path.1 ... path.N
+		void open(const std::string& path, size_t bufferSize, std::chrono::milliseconds flushInterval,
+			uint64_t maxFileSize, unsigned rotateKeep);
+		bool enabled() const;
+
+		void record(const Entry& entry);
+		// Called once per event loop turn, flushes a buffer older than the interval
+		void tick(std::chrono::steady_clock::time_point now);
+		void flush();
+
+	private:
+		struct File;
+
+		uint32_t intern(std::string_view text);
+		void appendString(std::string& out, uint32_t id, std::string_view text) const;
+
+		std::shared_ptr<File> _file;
+		std::string _buffer;
+		size_t _bufferSize;
+		std::chrono::milliseconds _flushInterval;
+		std::chrono::steady_clock::time_point _lastFlush;
+		uint16_t _writerId;
+		uint64_t _fileEpoch;  // file generation our string definitions were written to
+		std::unordered_map<std::string, uint32_t> _ids;
+		std::vector<std::string> _strings;
+};
@@ -0,0 +1,105 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLogFormat.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/17 11:03:12 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/17 11:03:12 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * On-disk layout of the binary access log, shared by the server and webServ-logdump.
+ * A file starts with AccessLogHeader, followed by a stream of entries in host byte order.
+ * Every entry starts with a 16-bit type. Request records have a fixed size.
+ * Strings (paths and virtual host names) are interned per writer: a string record
+ * defines (writer, id) -> text before the first request record that uses it. A later
+ * definition of the same pair replaces the earlier one, so the file is decoded in order.
+ */
+namespace accesslog
+{
+	constexpr char magic[4] = {'W', 'S', 'A', 'L'};
+	constexpr uint16_t version = 1;
+
+	enum EntryType : uint16_t
+	{
+		REQUEST = 1,
+		STRING = 2
+	};
+
+	enum Method : uint8_t
+	{
+		OTHER,
+		GET,
+		HEAD,
+		POST,
+		PUT,
+		DELETE,
+		OPTIONS,
+		PATCH
+	};
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint16_t version;
+		uint16_t recordSize;
+	};
+
+	struct RequestRecord
+	{
+		uint16_t type;          // REQUEST
+		uint16_t writer;        // worker that wrote the record, scopes the string ids
+		uint16_t status;
+		uint8_t method;
+		uint8_t addressFamily;  // 4 or 6, 0 when unknown
+		uint64_t timestamp;     // request start, microseconds since the epoch
+		uint32_t duration;      // microseconds until the response was queued
+		uint32_t vhost;         // string id
+		uint32_t path;          // string id, query string stripped
+		uint16_t port;
+		uint16_t reserved;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		uint8_t address[16];    // IPv4 in the first 4 bytes
+	};
+	static_assert(sizeof(RequestRecord) == 64, "access log records must stay 64 bytes");
+
+	// Followed by length bytes of text, padded to a multiple of 8
+	struct StringRecord
+	{
+		uint16_t type;          // STRING
+		uint16_t writer;
+		uint32_t id;
+		uint32_t length;
+		uint32_t reserved;
+	};
+
+	inline constexpr uint32_t padded(uint32_t length)
+	{
+		return (length + 7) & ~7u;
+	}
+
+	inline const char* methodName(uint8_t method)
+	{
+		static const char* const names[] = {"-", "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH"};
+		return method <= PATCH ? names[method] : names[OTHER];
+	}
+
+	inline Method methodCode(std::string_view method)
+	{
+		for (uint8_t code = GET; code <= PATCH; code++)
+		{
+			if (method == methodName(code))
+				return static_cast<Method>(code);
+		}
+		return OTHER;
+	}
+}
@@ -0,0 +1,98 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   BufferChain.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/09 11:02:17 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/09 11:02:17 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+// Owns an open file descriptor, shared by every segment that points into the file
+class FileHandle {
+	public:
+		explicit FileHandle(int fd);
+		~FileHandle();
+		FileHandle(const FileHandle&) = delete;
+		FileHandle& operator=(const FileHandle&) = delete;
+
+		int getFd() const;
+
+	private:
+		int _fd;
+};
+
+/**
+ * Outgoing bytes of a connection as a list of segments instead of one string.
+ * A segment is an owned heap block, a slice of a shared read-only blob or a region
+ * of an open file, so a body is never copied to be placed behind its headers.
+ * Written bytes are skipped with an offset into the front segment, never erased.
+ */
+class BufferChain {
+	public:
+		BufferChain() = default;
+		BufferChain(std::string data); // lets handlers keep returning plain strings
+		BufferChain(const char* data);
+
+		void append(std::string data);
+		void append(std::shared_ptr<const std::string> blob);
+		void append(std::shared_ptr<const std::string> blob, size_t offset, size_t length);
+		void append(std::shared_ptr<FileHandle> file, uint64_t offset, uint64_t length);
+		void append(BufferChain&& other);
+
+		// Inserts data at a byte position. A shared or file segment is split, head() then ends at the split
+		void insert(size_t position, std::string data);
+		// The in-memory bytes at the front of the chain, where a response keeps its headers
+		std::string_view head() const;
+
+		/**
+		 * Writes as much as the socket accepts: memory segments go out in one writev,
+		 * a file segment at the front is sent on its own, at most sendfileChunk bytes per call
+		 * so one large download cannot monopolise the loop. Returns bytes written or -1 with errno set.
+		 */
+		ssize_t writeTo(int fd);
+		void consume(uint64_t bytes);
+
+		bool empty() const;
+		uint64_t size() const;
+
+		static constexpr size_t sendfileChunk = 512 * 1024;
+
+	private:
+		enum Kind
+		{
+			OWNED,
+			SHARED,
+			FILE
+		};
+
+		struct Segment
+		{
+			Kind kind;
+			std::string owned;
+			std::shared_ptr<const std::string> blob;
+			std::shared_ptr<FileHandle> file;
+			uint64_t offset = 0; // 64-bit so file regions past 2 GB work on 32-bit builds too
+			uint64_t length = 0;
+
+			const char* data() const;
+		};
+
+		std::deque<Segment> _segments;
+		uint64_t _frontOffset = 0; // bytes of the front segment already written
+		uint64_t _size = 0;        // bytes not yet written
+
+		ssize_t writeFile(int fd, const Segment& segment);
+};
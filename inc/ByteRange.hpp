@@ -0,0 +1,43 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ByteRange.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/25 14:20:37 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/25 14:20:37 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Range header of a GET (RFC 9110 14.2). Ranges are resolved against the size of
+ * the representation, sorted and merged where they overlap or touch, so a client
+ * cannot make the server send the same bytes twice.
+ */
+namespace byterange
+{
+	struct Range
+	{
+		uint64_t first;
+		uint64_t length;
+	};
+
+	enum Result
+	{
+		IGNORED,       // not a bytes range or not valid, the whole file is sent
+		SATISFIABLE,
+		UNSATISFIABLE  // answered with 416
+	};
+
+	// More ranges than this after merging are ignored rather than answered part by part
+	constexpr size_t maxRanges = 32;
+
+	Result parse(std::string_view header, uint64_t size, std::vector<Range>& ranges);
+}
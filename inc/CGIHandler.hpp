@@ -12,6 +12,7 @@
 #include <signal.h>
 #include <cstring>
 #include <fcntl.h>
+#include "HTTPRequest.hpp"
 
 class CGIHandler {
 public:
@@ -26,19 +27,13 @@ public:
 		std::string requestMethod;
 	};
 
-	CGIHandler(const std::unordered_multimap<std::string, std::string>& serverConfig,
-			   const std::map<std::string, CGIConfig>& cgiConfig);
-
-	std::string executeCGI(const std::string& scriptPath, const std::string& method,
-						   const std::string& queryString, const std::string& requestBody);
-
-	void setCGIConfig(const std::map<std::string, CGIConfig>& cgiConfig);
-	const std::map<std::string, CGIConfig>& getCGIConfigs() const;
-	const CGIConfig& getCGIConfig(const std::string& requestPath) const;
+	// cgiConfig is the one of the request's location, resolved by the LocationRouter.
+	// A spooled request body becomes the script's stdin as is, one in memory is written through a pipe.
+	std::string executeCGI(const CGIConfig& cgiConfig, const std::string& scriptPath, const std::string& method,
+						   const std::string& queryString, const HTTPRequest& request);
 
 private:
 	std::unordered_multimap<std::string, std::string> _serverConfig;
-	std::map<std::string, CGIConfig> _cgiConfig;
 	static volatile sig_atomic_t timeoutOccurred;
 
 	static void handleTimeout(int signal);
@@ -0,0 +1,120 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/02 18:10:41 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/02 18:10:41 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <poll.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
+
+/**
+ * Readiness backend used by webServer::start.
+ * Every registered fd carries a tagged pointer to its owner (listening Socket or
+ * Connection), so a ready event is dispatched without searching for the fd.
+ * The tag lives in the low bit of the pointer, both owners are at least 2-byte aligned.
+ */
+class EventLoop {
+public:
+	enum Interest : uint32_t
+	{
+		READ = 1u << 0,
+		WRITE = 1u << 1,
+		EDGE = 1u << 2 // edge-triggered where the backend supports it, ignored by poll
+	};
+
+	enum Ready : uint32_t
+	{
+		READABLE = 1u << 0,
+		WRITABLE = 1u << 1,
+		HANGUP = 1u << 2,
+		ERROR = 1u << 3
+	};
+
+	enum Tag : uintptr_t
+	{
+		LISTENER = 0,
+		CONNECTION = 1
+	};
+
+	struct Event
+	{
+		void* data;
+		uint32_t ready;
+	};
+
+	virtual ~EventLoop() {}
+
+	virtual bool add(int fd, uint32_t interest, void* data) = 0;
+	virtual bool modify(int fd, uint32_t interest, void* data) = 0;
+	virtual void remove(int fd) = 0;
+	virtual int wait(std::vector<Event>& events, int timeoutMs) = 0;
+	virtual const char* name() const = 0;
+
+	static std::unique_ptr<EventLoop> create(const std::string& backend);
+
+	static void* tag(void* ptr, Tag tag)
+	{
+		return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) | tag);
+	}
+
+	static Tag tagOf(void* data)
+	{
+		return static_cast<Tag>(reinterpret_cast<uintptr_t>(data) & 1u);
+	}
+
+	template <typename T>
+	static T* untag(void* data)
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(data) & ~static_cast<uintptr_t>(1u));
+	}
+};
+
+// Portable fallback: keeps the pollfd array dense and an fd -> slot index for O(1) updates
+class PollEventLoop : public EventLoop {
+public:
+	bool add(int fd, uint32_t interest, void* data) override;
+	bool modify(int fd, uint32_t interest, void* data) override;
+	void remove(int fd) override;
+	int wait(std::vector<Event>& events, int timeoutMs) override;
+	const char* name() const override;
+
+private:
+	std::vector<pollfd> _pollFds;
+	std::vector<void*> _data;
+	std::unordered_map<int, size_t> _slots;
+};
+
+#ifdef __linux__
+class EpollEventLoop : public EventLoop {
+public:
+	EpollEventLoop();
+	~EpollEventLoop() override;
+	EpollEventLoop(const EpollEventLoop&) = delete;
+	EpollEventLoop& operator=(const EpollEventLoop&) = delete;
+
+	bool add(int fd, uint32_t interest, void* data) override;
+	bool modify(int fd, uint32_t interest, void* data) override;
+	void remove(int fd) override;
+	int wait(std::vector<Event>& events, int timeoutMs) override;
+	const char* name() const override;
+
+private:
+	int _epollFd;
+	std::vector<epoll_event> _buffer;
+};
+#endif
@@ -0,0 +1,121 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileCache.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/11 16:20:44 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/11 16:20:44 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <cstdint>
+#include "MimeTypes.hpp"
+
+/**
+ * Process-wide cache of small static files, keyed by normalized path and shared by
+ * every worker. An entry holds the complete 200 response (headers and body) ready to
+ * be queued as a shared blob.
+ *
+ * Keys are spread over shards, each with its own reader/writer lock, so hits from
+ * different workers only ever take a shared lock. Eviction is CLOCK per shard.
+ * Entries are never expired by time: an inotify thread watches the root directories
+ * and drops exactly the files that change. Files outside a watched root are not cached.
+ */
+class FileCache {
+	public:
+		struct CachedFile
+		{
+			std::shared_ptr<const std::string> response;
+			const MimeType* contentType;
+			uint64_t bodySize;
+		};
+
+		struct Stats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+			uint64_t invalidations;
+			uint64_t entries;
+			uint64_t bytes;
+		};
+
+		static FileCache& instance();
+
+		// Process-wide settings, every server block may call this, the largest limits win
+		void configure(size_t maxSize, size_t maxEntrySize, bool logStats);
+		void watch(const std::string& directory);
+
+		std::shared_ptr<const CachedFile> lookup(const std::string& path);
+		bool cacheable(const std::string& path, uint64_t fileSize) const;
+		// Taken before the file is read, insert() drops the entry if the file changed meanwhile
+		uint64_t generation(const std::string& path) const;
+		void insert(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t generation);
+		void invalidate(const std::string& path);
+		void clear();
+
+		Stats getStats() const;
+
+	private:
+		static constexpr size_t shardCount = 16;
+
+		struct Entry
+		{
+			std::shared_ptr<const CachedFile> file;
+			std::atomic<bool> referenced{true};
+			std::list<std::string>::iterator clockPosition;
+		};
+
+		struct alignas(64) Shard
+		{
+			mutable std::shared_mutex lock;
+			std::unordered_map<std::string, Entry> entries;
+			std::list<std::string> clock; // keys in insertion order, the hand sweeps it circularly
+			std::list<std::string>::iterator hand = clock.end();
+			size_t bytes = 0;
+			std::atomic<uint64_t> generation{0};
+			std::atomic<uint64_t> hits{0};
+			std::atomic<uint64_t> misses{0};
+			std::atomic<uint64_t> evictions{0};
+			std::atomic<uint64_t> invalidations{0};
+		};
+
+		FileCache();
+		FileCache(const FileCache&) = delete;
+		FileCache& operator=(const FileCache&) = delete;
+
+		Shard& shardFor(const std::string& key);
+		const Shard& shardFor(const std::string& key) const;
+		void erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+		bool evictOne(Shard& shard);
+
+		void addWatchTree(const std::string& directory);
+		void watchLoop();
+		void logStats() const;
+
+		Shard _shards[shardCount];
+		std::atomic<size_t> _maxSize{0};
+		std::atomic<size_t> _maxEntrySize{0};
+		std::atomic<bool> _logStats{false};
+
+		// Never modified once published: watch() swaps in a copy, cacheable() reads it without a lock
+		std::atomic<const std::vector<std::string>*> _roots{nullptr};
+
+		mutable std::shared_mutex _watchLock;
+		std::vector<std::unique_ptr<const std::vector<std::string>>> _rootSets; // every set ever published, kept for late readers
+		std::unordered_map<int, std::string> _watches; // inotify watch descriptor -> directory
+		std::atomic<int> _inotifyFd{-1};
+		bool _watchThreadStarted = false;
+};
@@ -13,15 +13,17 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
-#include "Colors.hpp"
+#include "Logger.hpp"
 
 class FileUtils {
 public:
 
-	static std::pair<std::vector<char>, std::string> readFile(const std::string& filePath);
-	static bool writeFile(const std::string& filePath, const std::string& content);
+	static std::pair<std::string, std::string> readFile(const std::string& filePath);
+	static bool readAll(int fd, char* buffer, size_t size);
+	static bool writeFile(const std::string& filePath, std::string_view content);
 	static bool createDirectoryIfNotExists(const std::string& dirPath);
 	static bool deleteFile(const std::string& filePath);
 };
@@ -13,27 +13,67 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
-#include <sstream>
-#include "Colors.hpp"
+#include <string_view>
+#include <cstdint>
+#include "Logger.hpp"
+#include "RequestBody.hpp"
 
+/**
+ * One request parsed in a single pass over the connection's buffer.
+ * Method, target, version and headers are views into that buffer, so it has to
+ * outlive the request, and parsing allocates nothing. A body that was streamed out
+ * of the buffer while it arrived is attached as a RequestBody handle instead. The headers the server acts on
+ * are kept in fixed slots, any other header is found by scanning the header section
+ * when it is asked for. Header names are matched case-insensitively.
+ */
 class HTTPRequest {
 	public:
-		HTTPRequest(const std::string& rawRequest);
-		std::string getMethod() const;
-		std::string getPath() const;
-		std::string getHeader(const std::string& key) const;
-		std::string getBody() const;
-		std::string getRawRequest() const;
-		std::string getContentTypeFromHeaders(const std::string& fullRequest);
+		enum Header
+		{
+			HOST,
+			CONTENT_LENGTH,
+			CONTENT_TYPE,
+			TRANSFER_ENCODING,
+			CONNECTION,
+			EXPECT,
+			RANGE,
+			IF_NONE_MATCH,
+			IF_MODIFIED_SINCE,
+			IF_RANGE,
+			ACCEPT_ENCODING,
+			KNOWN_HEADER_COUNT
+		};
+
+		HTTPRequest() = default;
+		explicit HTTPRequest(std::string_view rawRequest);
+
+		std::string_view getMethod() const;
+		std::string_view getPath() const;
+		std::string_view getVersion() const;
+		std::string_view getHeader(Header header) const;
+		std::string_view getHeader(std::string_view name) const;
+		std::string_view getBody() const;
+		std::string_view getRawRequest() const;
+
+		// The caller keeps the handle alive, getBody() then views it, mapping a spooled body
+		void setBody(const RequestBody& body);
+		const RequestBody* getBodyHandle() const;
+		int getBodyFile() const; // -1 unless the body is spooled to a file
+		uint64_t getBodySize() const;
+		// Trailer fields of a chunked body, CRLF terminated lines kept by the caller
+		void setTrailers(std::string_view trailers);
+		std::string_view getTrailer(std::string_view name) const;
 
 	private:
-		std::string method;
-		std::string path;
-		std::string version;
-		std::unordered_map<std::string, std::string> headers; // Holds key:value pairs from the header, e.g., ["Host"] = "localhost:8080"
-		std::string body;
-		std::string rawRequest;
-
-		void parseRequest(const std::string& rawRequest);
-	};
+		std::string_view _method;
+		std::string_view _path;
+		std::string_view _version;
+		std::string_view _fields; // header lines without the blank line, for headers that have no slot
+		std::string_view _headers[KNOWN_HEADER_COUNT];
+		std::string_view _body;
+		std::string_view _rawRequest;
+		std::string_view _trailers;
+		const RequestBody* _bodyHandle = nullptr;
+
+		void parseRequest(std::string_view rawRequest);
+};
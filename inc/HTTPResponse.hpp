@@ -13,16 +13,27 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <sstream>
-#include "Colors.hpp"
+#include <ctime>
+#include "Logger.hpp"
+#include "BufferChain.hpp"
+#include "MimeTypes.hpp"
 
 class HTTPResponse {
 	public:
 		HTTPResponse() : statusCode(200), contentType("text/plain"), body("") {}
-		HTTPResponse(int statusCode, const std::string& contentType, const std::string& body);
+		HTTPResponse(int statusCode, const std::string& contentType, std::string body);
 		static std::pair<std::string, std::string> getDefaultErrorPage(int errorCode);
 		static std::string getContentType(const std::string& filePath);
+		static std::string generateHeaders(int statusCode, const std::string& contentType, uint64_t contentLength);
+		// extraHeaders are complete CRLF terminated lines, e.g. the validators of a file
+		static std::string generateHeaders(int statusCode, const MimeType& contentType, uint64_t contentLength,
+			std::string_view extraHeaders = {});
+		static std::string httpDate(time_t time);
+		static bool parseHttpDate(std::string_view text, time_t& time);
 		std::string generateResponse() const;
+		BufferChain generateChain() &&;
 
 	private:
 		int statusCode;
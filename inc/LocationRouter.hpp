@@ -0,0 +1,98 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LocationRouter.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/21 09:12:48 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/21 09:12:48 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include "CGIHandler.hpp"
+
+// Directives written inside one location block, unset ones are inherited
+struct LocationDirectives
+{
+	std::optional<unsigned> methods;
+	std::optional<std::string> root;
+	std::optional<bool> autoindex;
+	std::optional<std::string> redirect; // "301 https://example.com"
+	std::optional<CGIHandler::CGIConfig> cgi;
+	std::optional<size_t> clientMaxBodySize;
+};
+
+// Everything a request needs to know about its location, resolved at startup
+struct LocationConfig
+{
+	enum Method : unsigned
+	{
+		GET = 1u << 0,
+		HEAD = 1u << 1,
+		POST = 1u << 2,
+		PUT = 1u << 3,
+		DELETE = 1u << 4,
+		OPTIONS = 1u << 5,
+		PATCH = 1u << 6,
+		OTHER = 1u << 7,
+		ALL_METHODS = ~0u
+	};
+
+	std::string path;                        // longest matching location, empty if none
+	unsigned methods = ALL_METHODS;
+	std::string root;                        // empty: the server root
+	std::string rootLocation;                // location that set root, replaced by it in file paths
+	bool autoindex = false;
+	std::string redirect;
+	bool cgiEnabled = false;
+	CGIHandler::CGIConfig cgi;
+	std::optional<size_t> clientMaxBodySize; // unset: the server's limit
+
+	static unsigned methodBit(std::string_view method);
+	bool allows(std::string_view method) const;
+};
+
+/**
+ * The location blocks of one server, compiled at startup into an immutable
+ * radix tree. Locations match as plain string prefixes and the longest one wins,
+ * per directive: a location that does not set root, methods, ... inherits them
+ * from the longest location that is a prefix of it. That inheritance is resolved
+ * while building, so routing a request is a single walk down the tree whatever
+ * the number of locations. Workers of a server block share one router.
+ */
+class LocationRouter
+{
+	public:
+		LocationRouter();
+		explicit LocationRouter(const std::map<std::string, LocationDirectives>& locations);
+
+		const LocationConfig& match(std::string_view path) const;
+
+		// Defaults first, then one resolved entry per location
+		const std::vector<LocationConfig>& getLocations() const;
+		size_t getNodeCount() const;
+
+	private:
+		struct Node
+		{
+			std::string label;
+			std::string edges;               // first byte of each child's label
+			std::vector<uint32_t> children;
+			uint32_t config = 0;             // 0: no location ends here
+		};
+
+		std::vector<Node> _nodes;            // _nodes[0] is the root, its label is empty
+		std::vector<LocationConfig> _configs;
+
+		void insert(std::string_view path, uint32_t config);
+		void resolve(uint32_t node, uint32_t inherited, const std::vector<const LocationDirectives*>& directives);
+};
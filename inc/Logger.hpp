@@ -0,0 +1,100 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Logger.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/16 09:12:40 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/16 09:12:40 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+// Lines below this level are compiled out, e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO
+#ifndef LOG_COMPILE_LEVEL
+# define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/**
+ * Asynchronous leveled logger.
+ * A log statement formats into a thread-local line buffer and copies the line into its
+ * thread's lock-free ring (single producer, single consumer). One background thread
+ * drains every ring and writes batches: DEBUG/INFO to stdout, WARN/ERROR to stderr.
+ * A full ring drops the line instead of blocking the event loop. The writer reports
+ * how many lines were dropped. Colors are only added when the sink is a terminal.
+ * Whatever is still buffered is written out at exit.
+ */
+class Logger {
+	public:
+		enum Level
+		{
+			DEBUG = LOG_LEVEL_DEBUG,
+			INFO = LOG_LEVEL_INFO,
+			WARN = LOG_LEVEL_WARN,
+			ERROR = LOG_LEVEL_ERROR
+		};
+
+		static Logger& instance();
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
+
+		static bool enabled(Level level)
+		{
+			return level >= _level.load(std::memory_order_relaxed);
+		}
+		// Process-wide, when several server blocks set log_level the most verbose one wins
+		void setLevel(Level level);
+		static Level parseLevel(const std::string& name);
+
+		// Formatting target of the LOG_* macros, reset for every line
+		static std::ostream& stream();
+		void commit(Level level);
+		uint64_t droppedLines() const;
+
+	private:
+		struct ThreadBuffer;
+
+		Logger();
+		static void shutdown();
+		ThreadBuffer& threadBuffer();
+		bool drain(std::ostream& out, std::ostream& err);
+		void writerLoop();
+
+		static std::atomic<int> _level;
+		bool _levelConfigured = false;
+		std::atomic<ThreadBuffer*> _buffers{nullptr}; // lock-free list, buffers live as long as the logger
+		std::atomic<bool> _stop{false};
+		bool _stdoutColors;
+		bool _stderrColors;
+		pid_t _pid; // a forked CGI child must not join the parent's writer
+		std::thread _writer;
+};
+
+#define LOG_AT(level, expr) \
+	do { \
+		if ((level) >= LOG_COMPILE_LEVEL && Logger::enabled(level)) \
+		{ \
+			Logger::stream() << expr; \
+			Logger::instance().commit(level); \
+		} \
+	} while (0)
+
+#define LOG_DEBUG(expr) LOG_AT(Logger::DEBUG, expr)
+#define LOG_INFO(expr) LOG_AT(Logger::INFO, expr)
+#define LOG_WARN(expr) LOG_AT(Logger::WARN, expr)
+#define LOG_ERROR(expr) LOG_AT(Logger::ERROR, expr)
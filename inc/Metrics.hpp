@@ -0,0 +1,99 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/18 10:31:06 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/18 10:31:06 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Request counters and per-phase latency histograms of one worker.
+ * Only the owning worker writes its shard, with relaxed load + store instead of an
+ * atomic read-modify-write, so counting costs a plain add and never bounces a cache
+ * line between workers. The status endpoint sums all shards when it is scraped.
+ */
+class Metrics {
+	public:
+		enum Phase
+		{
+			ACCEPT_TO_FIRST_BYTE,  // first request of a connection only
+			HEADER_PARSE,          // first byte until the header section is complete
+			ROUTING,               // handleRequest until a handler takes over
+			HANDLER_STATIC,        // GET, DELETE and directory listings
+			HANDLER_CGI,
+			HANDLER_UPLOAD,
+			RESPONSE_WRITE,        // first byte until last byte written
+			PHASE_COUNT
+		};
+
+		// Log-bucketed like HdrHistogram: 8 linear sub-buckets per power of two, about 12% precision
+		class Histogram {
+			public:
+				static constexpr size_t bucketCount = 320;
+
+				void record(uint64_t nanoseconds);
+				static size_t bucketOf(uint64_t value);
+				static uint64_t bucketUpperBound(size_t bucket);
+
+			private:
+				friend class Metrics;
+				std::atomic<uint64_t> _buckets[bucketCount] = {};
+				std::atomic<uint64_t> _count{0};
+				std::atomic<uint64_t> _sum{0};
+				std::atomic<uint64_t> _max{0};
+		};
+
+		Metrics();
+		~Metrics();
+		Metrics(const Metrics&) = delete;
+		Metrics& operator=(const Metrics&) = delete;
+
+		void recordPhase(Phase phase, std::chrono::steady_clock::duration duration);
+		void countRequest(std::string_view vhost, std::string_view location, int status);
+		void connectionOpened();
+		void connectionClosed();
+
+		// Sum over every worker of the process
+		static std::string renderPrometheus();
+		static std::string renderJson();
+
+	private:
+		struct Aggregate;
+
+		struct StatusCounters
+		{
+			std::atomic<uint64_t> byClass[6] = {}; // index 1-5 for 1xx-5xx, 0 for anything else
+		};
+
+		static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+		static Aggregate collect();
+
+		Histogram _phases[PHASE_COUNT];
+		std::atomic<uint64_t> _accepted{0};
+		std::atomic<uint64_t> _active{0};
+
+		// Distinct vhost/location pairs per worker, later ones are counted as vhost "other"
+		static constexpr size_t maxRequestSeries = 1024;
+
+		// vhost + '\n' + location -> counters, the lock only guards inserts against a concurrent scrape
+		std::mutex _requestsLock;
+		std::unordered_map<std::string, StatusCounters> _requests;
+};
@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/22 11:37:05 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/22 11:37:05 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+struct MimeType
+{
+	std::string name;       // "text/html"
+	std::string headerLine; // "Content-Type: text/html; charset=utf-8\r\n"
+};
+
+/**
+ * Process-wide extension to MIME type table. It starts with a built-in set of
+ * common types; the types blocks and included mime.types files of every server
+ * block are added on top, a later definition of an extension replacing an
+ * earlier one. compile() turns that into a perfect hash: each extension hashes to
+ * a bucket, and each bucket stores the seed that sends its extensions to free
+ * slots of one flat array. A lookup is two hashes and one case-insensitive
+ * compare, without allocating. Types are compiled before the workers start and
+ * never change afterwards, so the MimeType references stay valid.
+ */
+class MimeTypes
+{
+	public:
+		static MimeTypes& instance();
+
+		// Startup only, before any worker reads the table
+		void add(std::string_view type, std::string_view extension);
+		void setCharset(std::string_view charset); // "off" sends no charset
+		void compile();
+
+		// By the extension of path, application/octet-stream when there is none or it is unknown
+		const MimeType& lookup(std::string_view path) const;
+
+		size_t getTypeCount() const;
+		size_t getSlotCount() const;
+
+	private:
+		MimeTypes();
+
+		struct Slot
+		{
+			std::string extension; // lowercase, empty for a free slot
+			uint32_t type = 0;
+		};
+
+		static uint32_t hash(std::string_view extension, uint32_t seed);
+		bool place(const std::vector<std::vector<std::string>>& buckets, size_t slotCount);
+
+		std::map<std::string, std::string> _extensions; // staged by add(), extension to type
+		std::string _charset = "utf-8";
+
+		std::vector<MimeType> _types; // _types[0] is application/octet-stream
+		std::vector<uint32_t> _seeds; // one per bucket
+		std::vector<Slot> _slots;
+		uint32_t _bucketMask = 0;
+		uint32_t _slotMask = 0;
+};
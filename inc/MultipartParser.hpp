@@ -0,0 +1,87 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MultipartParser.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/24 10:41:52 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/24 10:41:52 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "RequestBody.hpp"
+
+/**
+ * Push parser for multipart/form-data, fed the body in whatever pieces the
+ * request reader has. File parts are written through an fd while they stream
+ * in, form fields are only measured. Besides the header section of the part
+ * being read, it keeps no more than a delimiter's length of unread bytes, so
+ * memory does not grow with the size or the number of parts.
+ */
+class MultipartParser : public BodySink {
+	public:
+		struct Part
+		{
+			std::string name;        // form field name from Content-Disposition
+			std::string filename;    // as sent by the client, empty for a plain field
+			std::string contentType; // text/plain when the part has none
+			std::string savedAs;     // path the file part was written to
+			uint64_t size = 0;
+			bool isFile = false;
+		};
+
+		// Picks the file a part with a filename is stored in, an empty path fails the upload
+		using PathFor = std::function<std::string(const Part&)>;
+
+		MultipartParser(std::string_view boundary, PathFor pathFor);
+		~MultipartParser();
+
+		MultipartParser(const MultipartParser&) = delete;
+		MultipartParser& operator=(const MultipartParser&) = delete;
+
+		// The boundary parameter of a multipart Content-Type, false if it is missing or invalid
+		static bool boundaryOf(std::string_view contentType, std::string& boundary);
+
+		// False only when a file part cannot be written, a malformed body is reported by finish()
+		bool write(std::string_view data) override;
+		// Call once the body is complete. On failure the files written so far are removed.
+		bool finish();
+
+		int getErrorStatus() const;
+		const std::vector<Part>& getParts() const;
+
+	private:
+		enum State
+		{
+			PREAMBLE,
+			BOUNDARY_END,
+			PART_HEADERS,
+			PART_BODY,
+			EPILOGUE,
+			FAILED
+		};
+
+		State _state;
+		std::string _delimiter; // "\r\n--" + boundary
+		std::string _window;    // bytes that could not be decided on yet
+		PathFor _pathFor;
+		std::vector<Part> _parts;
+		int _fd;
+		int _errorStatus;
+		bool _finished;
+
+		size_t consume(std::string_view data);
+		bool beginPart(std::string_view headers);
+		bool emit(std::string_view data);
+		void endPart();
+		void fail(int status);
+		void removeFiles();
+};
@@ -0,0 +1,85 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OpenFileCache.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/13 10:41:26 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/13 10:41:26 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/stat.h>
+#include "BufferChain.hpp"
+#include "MimeTypes.hpp"
+
+/**
+ * Per-worker table of open files and their metadata, in the spirit of nginx's open_file_cache.
+ * A fresh entry answers "does it exist, is it a directory, how big, which MIME type"
+ * without a single syscall, so a static hit costs only the sendfile calls.
+ * Entries are rechecked with one stat() once they are older than the validity interval.
+ * stat() fills an entry from metadata alone, for answers that never touch the
+ * contents (HEAD, 304); a later get() of that path opens the file.
+ * The fd is shared through FileHandle, so a transfer still in flight keeps it open
+ * even after its entry was evicted or replaced.
+ * Each worker owns its cache, so no locking is needed.
+ */
+class OpenFileCache {
+	public:
+		struct FileInfo
+		{
+			std::shared_ptr<FileHandle> file; // null for directories, failed lookups and stat() entries
+			int error = 0;                    // errno of the failed open, 0 when the path exists
+			bool isDirectory = false;
+			uint64_t size = 0;
+			struct timespec mtime = {};
+			dev_t device = 0;
+			ino_t inode = 0;
+			const MimeType* contentType = nullptr; // entry of the process-wide MimeTypes table
+			std::string etag;                 // strong, "inode-size-mtime" in hex, quoted
+			std::string lastModified;         // mtime as an HTTP date
+		};
+
+		OpenFileCache();
+
+		void configure(size_t maxEntries, std::chrono::milliseconds valid, bool cacheErrors);
+		// revalidate forces the stat check even if the entry is still fresh
+		std::shared_ptr<const FileInfo> get(const std::string& path, bool revalidate = false);
+		// Metadata without opening the file, any fresh entry answers it
+		std::shared_ptr<const FileInfo> stat(const std::string& path);
+		void invalidate(const std::string& path);
+		// Returns how many entries gave up their fd, for callers that hit EMFILE or ENFILE
+		size_t releaseFiles(size_t count);
+
+		static bool outOfFiles(int error);
+
+	private:
+		struct Entry
+		{
+			std::shared_ptr<const FileInfo> info;
+			std::chrono::steady_clock::time_point validated;
+			std::list<std::string>::iterator lruPosition;
+		};
+
+		std::shared_ptr<const FileInfo> lookup(const std::string& path, bool revalidate, bool openFile);
+		static std::shared_ptr<const FileInfo> load(const std::string& path);
+		static std::shared_ptr<const FileInfo> loadMetadata(const std::string& path);
+		static void describe(FileInfo& info, const struct stat& st, const std::string& path);
+		static bool unchanged(const FileInfo& info, const struct stat& st);
+		static bool describesPath(int error);
+
+		size_t _maxEntries;
+		std::chrono::milliseconds _valid;
+		bool _cacheErrors;
+		std::unordered_map<std::string, Entry> _entries;
+		std::list<std::string> _lru; // most recently used first
+};
@@ -21,6 +21,7 @@
 #include <string>
 #include <map>
 #include "WebServer.hpp"
+#include "LocationRouter.hpp"
 
 class parseConfig {
 	public:
@@ -54,9 +55,13 @@ class parseConfig {
 		const std::string& getIndex() const;
 		const std::map<std::string, bool>& getAutoindexConfig() const;
 		const parseConfig::CGIConfig& getCGIConfig(const std::string& location) const;
+		int getWorkerCount() const;
+		std::map<std::string, LocationDirectives> getLocationDirectives() const;
+		const std::vector<std::pair<std::string, std::string>>& getMimeTypes() const;
 
 		// **Public Setter & Parsing Functions**
 		void parseClientMaxBodySize(const std::string& line);
+		static size_t parseSize(const std::string& value);
 		void parse(const std::string& filename);
 
 		// **Error Handling**
@@ -76,6 +81,9 @@ class parseConfig {
 		// **Configuration Data Structures**
 		std::map<std::string, CGIConfig> _cgiConfig;
 		std::map<std::string, size_t> _clientMaxBodySize;
+		std::map<std::string, size_t> _locationBodySizes;
+		std::vector<std::pair<std::string, std::string>> _mimeTypes; // type and extension, in config order
+		bool _inTypes = false;
 		std::map<std::string, std::string> _serverNames;
 		std::map<std::string, std::string> _errorPages;
 		std::map<std::string, std::string> _rootDirectories;
@@ -88,4 +96,6 @@ class parseConfig {
 		std::string trimLocation(const std::string& line);
 		std::string trim(const std::string& line);
 		void fillLocationMap(std::string& line, const std::string& location);
+		void parseTypes(const std::string& text);
+		void includeTypes(const std::string& path);
 };
@@ -0,0 +1,64 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestBody.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/23 16:02:19 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/23 16:02:19 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+/**
+ * Receives a request body piece by piece while it is decoded, so the raw bytes
+ * can leave the connection buffer as soon as they have been handed over.
+ */
+class BodySink {
+	public:
+		virtual ~BodySink() = default;
+		// False once the bytes cannot be stored, the request is then answered with 500
+		virtual bool write(std::string_view data) = 0;
+};
+
+/**
+ * The body handle a handler receives. Up to client_body_buffer_size bytes are
+ * kept in memory, a larger body moves to an unlinked temporary file as soon as
+ * it crosses that size, so its bytes never pile up in the worker. Either way it
+ * can be viewed as one block of bytes, the file mapped on demand, or its fd can
+ * be handed on as is, e.g. as the stdin of a CGI script.
+ */
+class RequestBody : public BodySink {
+	public:
+		RequestBody(size_t bufferSize, std::string tempPath);
+		~RequestBody();
+
+		RequestBody(const RequestBody&) = delete;
+		RequestBody& operator=(const RequestBody&) = delete;
+
+		// False once a spool file cannot be created or written
+		bool write(std::string_view data) override;
+
+		uint64_t size() const;
+		bool inFile() const;
+		// The whole body, a spooled one is mapped on the first call. Empty if that fails.
+		std::string_view data() const;
+		int getFd() const; // -1 while the body is in memory
+
+	private:
+		bool spool();
+
+		std::string _data;
+		size_t _bufferSize;
+		std::string _tempPath;
+		int _fd = -1;
+		uint64_t _size = 0;
+		mutable void* _map = nullptr;
+};
@@ -0,0 +1,105 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestParser.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/06 14:21:37 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/06 14:21:37 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "RequestBody.hpp"
+
+/**
+ * Resumable framing parser, one per Connection.
+ * parse() is called with the connection's pending bytes after every read and
+ * continues where the previous call stopped, so no byte is scanned twice and a
+ * slow client never makes the server wait for the rest of its request.
+ * It only finds where a request ends, HTTPRequest does the full header parsing.
+ * When a body sink is set, the body is pushed into it as it arrives, a chunked
+ * one decoded, after which releaseBody() lets the caller drop the raw bytes
+ * from its buffer. Without a sink a Content-Length body stays in the buffer.
+ */
+class RequestParser {
+	public:
+		enum State
+		{
+			REQUEST_LINE,
+			HEADERS,
+			BODY_LENGTH,
+			BODY_CHUNKED,
+			DONE,
+			FAILED
+		};
+
+		RequestParser();
+
+		void setMaxHeaderSize(size_t maxHeaderSize);
+		State parse(std::string_view pending);
+		void reset();
+
+		// After the headers, parse() pauses until the caller sets the body limit for the resolved Host
+		bool awaitingBodyLimit() const;
+		void setBodyLimit(size_t maxBodySize);
+		// Body bytes go here, set together with the body limit. Required for a chunked body.
+		void setBodySink(BodySink* sink);
+		// Raw body bytes already in the sink, to be erased right after the header section
+		size_t releaseBody();
+
+		State getState() const;
+		int getErrorStatus() const;
+		size_t getRequestStart() const;
+		size_t getHeaderLength() const;
+		size_t getRequestLength() const;
+		bool isChunked() const;
+		bool expectsContinue() const;
+		const std::string& getHost() const;
+		size_t getReleasedBytes() const;
+		uint64_t getDecodedSize() const;
+		// Trailer field lines of a chunked body, each ending in CRLF
+		const std::string& getTrailers() const;
+
+	private:
+		enum ChunkState
+		{
+			CHUNK_SIZE,
+			CHUNK_DATA,
+			CHUNK_DATA_END,
+			CHUNK_TRAILERS
+		};
+
+		State _state;
+		ChunkState _chunkState;
+		size_t _maxHeaderSize;
+		size_t _bodyLimit;
+		bool _bodyLimitSet;
+		size_t _requestStart;    // skips stray CRLFs in front of the request line
+		size_t _fieldsStart;     // first byte after the request line
+		size_t _scanOffset;      // first byte not yet examined
+		size_t _headerLength;    // bytes up to and including the blank line
+		size_t _contentLength;
+		size_t _chunkRemaining;
+		bool _chunked;
+		bool _expectContinue;
+		int _errorStatus;
+		std::string _host;
+		BodySink* _bodySink;
+		uint64_t _decodedSize;   // payload bytes handed to the sink so far
+		size_t _released;        // raw body bytes handed back through releaseBody()
+		std::string _trailers;
+
+		State fail(int status);
+		State parseRequestLine(std::string_view pending);
+		State parseHeaders(std::string_view pending);
+		State parseHeaderFields(std::string_view fields);
+		State parseLength(std::string_view pending);
+		State parseChunked(std::string_view pending);
+};
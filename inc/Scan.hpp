@@ -0,0 +1,48 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Scan.hpp                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/20 10:05:33 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/20 10:05:33 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+
+/**
+ * Delimiter search for the request path, with SSE2 and AVX2 kernels and a scalar
+ * fallback. The widest kernel set the CPU supports is picked once through CPUID,
+ * every search takes a start offset so a caller can resume where it stopped.
+ * All functions return std::string_view::npos when nothing is found.
+ */
+namespace scan
+{
+	enum Level
+	{
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+
+	// Offset of the "\r\n\r\n" that ends a header section
+	size_t findHeaderEnd(std::string_view data, size_t from = 0);
+	// Offset of the next "\r\n"
+	size_t findLineEnd(std::string_view data, size_t from = 0);
+	// Substring search, prefiltered on the first and last byte of the needle
+	size_t find(std::string_view haystack, std::string_view needle, size_t from = 0);
+
+	// Pops the next CRLF terminated line off rest, the last line may lack its terminator
+	std::string_view nextLine(std::string_view& rest);
+
+	Level bestLevel();
+	Level activeLevel();
+	// Switches kernels for the microbench, false if the CPU lacks them. Not thread-safe.
+	bool setLevel(Level level);
+	const char* levelName(Level level);
+}
@@ -13,29 +13,25 @@
 #pragma once
 
 #include <vector>
-#include <poll.h>
 #include <netinet/in.h>
 #include <stdexcept>
-#include <iostream>
 #include "Socket.hpp"
 #include <optional>
-#include "Colors.hpp"
+#include "Logger.hpp"
 
 class SocketManager {
 public:
 	SocketManager();
 	~SocketManager();
 
-	void createSocket(int port);
-	std::optional<int> acceptConnection(int serverFd);
-	void closeSocket(int fd);
+	void createSocket(int port, bool reusePort = false, int backlog = 511);
+	// nullopt with errno set, EAGAIN once the queue is empty
+	std::optional<int> acceptConnection(int serverFd, struct sockaddr_storage* peer = nullptr);
 	void setNonBlocking(int socketFd);
-	std::vector<pollfd>& getPollFds();
 	std::vector<Socket>& getServerSockets();
-	std::optional<std::string> isPortAvailable(int port);
+	bool isPortInUse(int port);
 
 private:
 	std::vector<Socket> _serverSockets;
-	std::vector<pollfd> _pollFds;
 
 };
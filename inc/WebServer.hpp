@@ -33,50 +33,62 @@
 #include <sys/stat.h>
 #include "Socket.hpp"
 #include "SocketManager.hpp"
+#include "EventLoop.hpp"
 #include "HTTPRequest.hpp"
+#include "RequestParser.hpp"
 #include "ParseConfig.hpp"
 #include "CGIHandler.hpp"
+#include "BufferChain.hpp"
+#include "FileCache.hpp"
+#include "OpenFileCache.hpp"
+#include "AccessLog.hpp"
+#include "Metrics.hpp"
+#include "Scan.hpp"
+#include "LocationRouter.hpp"
+#include "MultipartParser.hpp"
 #include <map>
-#include "Colors.hpp"
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include "Logger.hpp"
 
 class webServer {
 	public:
 		// Constructor
 		webServer(const std::unordered_multimap<std::string, std::string>& serverConfig,
-				  const std::unordered_multimap<std::string, std::vector<std::string>>& locationConfig);
+				  const std::unordered_multimap<std::string, std::vector<std::string>>& locationConfig,
+				  int workerId = 0, int workerCount = 1);
 
 		// Server control functions
 		void start();
-		void addConnection(int clientFd, const std::string& serverName);
+		void addConnection(int clientFd, const std::string& serverName, const struct sockaddr_storage& peer = {});
 		void closeConnection(int fd);
 
 		// Request handling
-		std::string readFullRequest(int clientSocket);
-		std::string handleRequest(const std::string& fullRequest);
+		BufferChain handleRequest(const HTTPRequest& request);
 
 		// Response handling
 		void sendResponse(Socket& clientSocket, const std::string& response);
-		std::string generateResponse(const HTTPRequest& request);
-		std::string generateDeleteResponse(const std::string& filePath);
-		std::string generateMethodNotAllowedResponse();
-		std::string generatePostResponse(const std::string& requestBody, const std::string& contentType);
-		std::string generateGetResponse(const std::string& filePath);
-		std::string generateErrorResponse(int statusCode, const std::string& message);
-		std::string generateSuccessResponse(const std::string& message);
-		std::string generateDirectoryListing(const std::string& directoryPath, const std::string& requestPath);
+		BufferChain generateResponse(const HTTPRequest& request);
+		BufferChain generateDeleteResponse(const std::string& filePath);
+		BufferChain generateMethodNotAllowedResponse();
+		BufferChain generatePostResponse(std::string_view requestBody, const std::string& contentType);
+		BufferChain generateGetResponse(const std::string& filePath, const HTTPRequest* request = nullptr);
+		BufferChain generateErrorResponse(int statusCode, const std::string& message);
+		BufferChain generateSuccessResponse(const std::string& message);
+		BufferChain generateDirectoryListing(const std::string& directoryPath, const std::string& requestPath);
 
 		// Configuration setters
-		void setAutoindexConfig(const std::map<std::string, bool>& autoindexConfig);
-		void setRedirections(const std::map<std::string, std::string>& redirections);
+		void setRouter(std::shared_ptr<const LocationRouter> router);
 		void setServerNames(const std::map<std::string, std::string>& serverNames);
 		void setClientMaxBodySize(const std::string& serverName, size_t size);
-		void setRootDirectories(const std::map<std::string, std::string>& rootDirectories);
-		void setAllowedMethods(const std::map<std::string, std::vector<std::string>>& allowedMethods);
+		void setErrorPages(const std::map<std::string, std::string>& errorPages);
+		void warmCaches();
 
 		// Configuration getters
 		size_t getClientMaxBodySize(const std::string& serverName) const;
 		size_t getContentLength(const std::unordered_map<std::string, std::string>& headers);
-		std::vector<std::string> getAllowedMethods(const std::string& location) const;
 
 		// Utility functions
 		std::string sanitizePath(const std::string& path);
@@ -85,14 +97,21 @@ class webServer {
 		std::string getStatusMessage(int statusCode);
 		std::string getFilePath(const std::string& path);
 		std::string resolveFilePath(const std::string& path, const std::string& rootDir);
+		std::unordered_map<std::string, std::string> parseHeaders(std::string_view headerSection);
 
 		// Upload handling
-		std::string handleMultipartUpload(const std::string& requestBody, const std::string& contentType, const std::string& uploadDir);
-		std::string handleFormUrlEncodedUpload(const std::string& requestBody, const std::string& uploadDir);
-		std::string handleTextUpload(const std::string& requestBody, const std::string& uploadDir);
+		BufferChain handleMultipartUpload(std::string_view requestBody, const std::string& contentType, const std::string& uploadDir);
+		BufferChain finishMultipartUpload(MultipartParser& upload);
+		BufferChain handleFormUrlEncodedUpload(std::string_view requestBody, const std::string& uploadDir);
+		BufferChain handleTextUpload(std::string_view requestBody, const std::string& uploadDir);
 
-		// Public member variables
-		int _formNumber = 0;
+		// Public member variables, shared by every worker so upload names never collide
+		static std::atomic<int> _formNumber;
+
+		// SIGHUP handler, every worker reloads its error pages on its next loop iteration
+		static void requestReload(int signal);
+		// Cached open files each worker may keep, set once from RLIMIT_NOFILE before the workers are built
+		static void setOpenFileBudget(size_t perWorker);
 
 		CGIHandler& getCGIHandler();
 
@@ -102,35 +121,104 @@ class webServer {
 		{
 			Socket socket;
 			std::string inputBuffer;
-			std::string outputBuffer;
-			bool requestComplete;
+			RequestParser parser;
+			BufferChain output; // pipelined responses, in request order
 			int cgiPipeIn[2];
 			int cgiPipeOut[2];
 			pid_t cgiPid;
 			std::string serverName;
+			bool keepAlive = true;
+			size_t requestsServed = 0;
+			std::chrono::steady_clock::time_point lastActivity;
+			struct sockaddr_storage peer = {};
+			std::chrono::steady_clock::time_point acceptedAt;
+			std::chrono::steady_clock::time_point requestBegin; // first byte of the request being parsed
+			bool requestPending = false;
+			bool headersParsed = false;
+			std::chrono::steady_clock::time_point writeBegin;   // first byte of the queued responses
+			bool writing = false;
+			std::unique_ptr<RequestBody> body;                   // body of the request being read, unless it is an upload
+			std::unique_ptr<MultipartParser> upload;             // multipart upload streamed to disk while it is read
 		};
 
-		// Internal request processing
-		void processRead(int clientSocket);
-		void processWrite(int clientSocket);
-		void updatePollEvents(int fd, short newEvent);
+		// Internal request processing, both return false once the connection has been closed
+		void acceptConnections(Socket& serverSocket);
+		bool processRead(Connection& conn);
+		bool processWrite(Connection& conn);
+		bool readAvailable(Connection& conn);
+		void onHeadersParsed(Connection& conn, std::string_view pending);
+		std::unique_ptr<MultipartParser> streamUpload(const HTTPRequest& head, const LocationConfig& location);
+		std::string getUploadDir() const;
+		MultipartParser::PathFor uploadPathFor(const std::string& uploadDir);
+		std::string routePath(std::string_view target);
+		std::string mapToRoot(std::string_view path, const LocationConfig& location, const std::string& rootDir) const;
+		void updateEvents(Connection& conn, uint32_t interest);
+		bool wantsKeepAlive(const HTTPRequest& request) const;
+		void setConnectionHeader(BufferChain& response, Connection& conn) const;
+		void recordRequest(Connection& conn, const HTTPRequest* request, uint64_t bytesIn, const BufferChain& response);
+		BufferChain generateStatusResponse(const HTTPRequest& request);
+		std::optional<BufferChain> generateRangeResponse(const OpenFileCache::FileInfo& info, const HTTPRequest& request);
+		void beginHandler(Metrics::Phase handler);
+		void closeIdleConnections();
+		void loadErrorPages();
+		std::shared_ptr<const std::string> buildErrorPage(int statusCode);
 
 		// Member variables
-		std::map<std::string, std::vector<std::string>> _allowedMethods;
 		std::map<std::string, size_t> _clientMaxBodySizes;
-		std::map<std::string, bool> _autoindexConfig;
 		std::map<std::string, std::string> _serverNames;
-		std::map<std::string, std::string> _redirections;
-		std::map<std::string, std::string> _rootDirectories;
+		std::string _metricsVhost; // first server_name of the block, never the client's Host
+		std::shared_ptr<const LocationRouter> _router; // location blocks, shared by the workers of a server block
 		std::unordered_multimap<std::string, std::string> _serverConfig;
 		std::unordered_multimap<std::string, std::vector<std::string>> _locationConfig;
-		std::unordered_map<int, Connection> _connections;
-		std::vector<struct pollfd> _pollfds;
-
-		// Parsing functions
-		std::unordered_map<std::string, std::string> parseHeaders(const std::string& headerSection);
+		std::unordered_map<int, Connection> _connections; // node based, Connection addresses stay valid for the event loop
+
+		// Index of this event loop among the workers of its server block
+		int _workerId;
+
+		// Persistent connections, keepalive_timeout 0 turns them off
+		std::chrono::seconds _keepaliveTimeout{75};
+		size_t _keepaliveRequests = 100;
+		std::chrono::steady_clock::time_point _lastIdleSweep;
+		// Listeners that stopped at EMFILE/ENFILE with clients still queued, retried by the idle sweep
+		std::vector<Socket*> _acceptBlocked;
+
+		// Larger request line + header sections are refused with 414/431
+		size_t _maxHeaderSize = 16384;
+
+		// Request bodies above the buffer size are spooled to unlinked files in the temp path
+		size_t _bodyBufferSize = 16384;
+		std::string _bodyTempPath = "/tmp";
+
+		// Complete error responses by status code, built once from error_pages and sent as shared blobs
+		std::map<std::string, std::string> _errorPagePaths;
+		std::unordered_map<int, std::shared_ptr<const std::string>> _errorResponses;
+		static std::atomic<unsigned> _reloadGeneration;
+		unsigned _reloadSeen = 0;
+
+		// Open fds and metadata of recently served paths, owned by this worker
+		OpenFileCache _openFiles;
+		static size_t _openFileBudget;
+
+		// Binary access log, off unless access_log is set
+		AccessLog _accessLog;
+
+		// This worker's counters and latency histograms, served on status_endpoint
+		Metrics _metrics;
+		std::string _statusPath;
+		struct Route
+		{
+			std::string location;                              // longest matching location, empty if none
+			Metrics::Phase handler = Metrics::HANDLER_STATIC;
+			std::chrono::steady_clock::time_point handlerBegin; // unset while still routing
+		};
+		Route _route; // of the request handleRequest is answering
+		MultipartParser* _upload = nullptr; // its body, when that was parsed into files while it arrived
 
 		// Socket manager instance
 		SocketManager _socketManager;
+		std::unique_ptr<EventLoop> _eventLoop;
 		CGIHandler _cgiHandler;
 };
+
+// Percent-decodes a request path or query string
+std::string urlDecode(std::string_view encoded);
@@ -0,0 +1,235 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/17 11:20:37 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/17 11:20:37 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "AccessLog.hpp"
+#include "Logger.hpp"
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+using namespace accesslog;
+
+// A writer that saw this many distinct strings starts over, the decoder follows the redefinitions
+static constexpr size_t maxStrings = 64 * 1024;
+
+struct AccessLog::File
+{
+	std::mutex lock;
+	std::string path;
+	int fd = -1;
+	uint64_t size = 0;
+	uint64_t maxSize = 0;
+	unsigned keep = 0;
+	uint64_t epoch = 1;  // bumped on every rotation, writers then repeat their string definitions
+	bool failed = false;
+
+	~File()
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+
+	bool open()
+	{
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		size = (fstat(fd, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+		if (size == 0)
+		{
+			FileHeader header = {{magic[0], magic[1], magic[2], magic[3]}, version, sizeof(RequestRecord)};
+			if (write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)))
+				size = sizeof(header);
+		}
+		return true;
+	}
+
+	// access.log -> access.log.1 -> ... -> access.log.N, the oldest one is overwritten
+	void rotate()
+	{
+		close(fd);
+		for (unsigned k = keep; k > 1; k--)
+			rename((path + "." + std::to_string(k - 1)).c_str(), (path + "." + std::to_string(k)).c_str());
+		if (keep > 0)
+			rename(path.c_str(), (path + ".1").c_str());
+		else
+			unlink(path.c_str());
+		if (!open())
+			LOG_ERROR("Cannot reopen access log " << path << ": " << strerror(errno));
+		epoch++;
+	}
+};
+
+AccessLog::AccessLog()
+	: _bufferSize(0), _flushInterval(0), _writerId(0), _fileEpoch(0)
+{
+}
+
+AccessLog::~AccessLog()
+{
+	flush();
+}
+
+void AccessLog::open(const std::string& path, size_t bufferSize, std::chrono::milliseconds flushInterval,
+	uint64_t maxFileSize, unsigned rotateKeep)
+{
+	static std::mutex registryLock;
+	static std::map<std::string, std::weak_ptr<File>> registry;
+	static std::atomic<uint16_t> nextWriter{0};
+
+	std::lock_guard<std::mutex> guard(registryLock);
+	std::shared_ptr<File> file = registry[path].lock();
+	if (!file)
+	{
+		file = std::make_shared<File>();
+		file->path = path;
+		file->maxSize = maxFileSize;
+		file->keep = rotateKeep;
+		if (!file->open())
+			throw std::runtime_error("Cannot open access log " + path + ": " + strerror(errno));
+		registry[path] = file;
+	}
+
+	_file = file;
+	_bufferSize = std::max<size_t>(bufferSize, sizeof(RequestRecord));
+	_buffer.reserve(_bufferSize + sizeof(RequestRecord));
+	_flushInterval = flushInterval;
+	_lastFlush = std::chrono::steady_clock::now();
+	_writerId = nextWriter++;
+	_fileEpoch = file->epoch;
+}
+
+bool AccessLog::enabled() const
+{
+	return _file != nullptr;
+}
+
+uint32_t AccessLog::intern(std::string_view text)
+{
+	static thread_local std::string key;
+	key.assign(text.data(), text.size());
+	auto it = _ids.find(key);
+	if (it != _ids.end())
+		return it->second;
+
+	uint32_t id = static_cast<uint32_t>(_strings.size());
+	_strings.push_back(key);
+	_ids.emplace(key, id);
+	appendString(_buffer, id, text);
+	return id;
+}
+
+void AccessLog::appendString(std::string& out, uint32_t id, std::string_view text) const
+{
+	StringRecord header = {STRING, _writerId, id, static_cast<uint32_t>(text.size()), 0};
+	out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.append(text.data(), text.size());
+	out.append(padded(header.length) - header.length, '\0');
+}
+
+void AccessLog::record(const Entry& entry)
+{
+	if (!_file)
+		return;
+	if (_strings.size() + 2 > maxStrings)
+	{
+		_ids.clear();
+		_strings.clear();
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - entry.begin;
+	auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch() - elapsed;
+
+	RequestRecord record = {};
+	record.type = REQUEST;
+	record.writer = _writerId;
+	record.status = static_cast<uint16_t>(entry.status);
+	record.method = methodCode(entry.method);
+	record.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch).count();
+	record.duration = static_cast<uint32_t>(std::min<int64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), UINT32_MAX));
+	record.vhost = intern(entry.vhost);
+	record.path = intern(entry.path.substr(0, entry.path.find('?')));
+	record.bytesIn = entry.bytesIn;
+	record.bytesOut = entry.bytesOut;
+
+	if (entry.peer && entry.peer->ss_family == AF_INET)
+	{
+		const struct sockaddr_in* peer = reinterpret_cast<const struct sockaddr_in*>(entry.peer);
+		record.addressFamily = 4;
+		std::memcpy(record.address, &peer->sin_addr, sizeof(peer->sin_addr));
+		record.port = ntohs(peer->sin_port);
+	}
+	else if (entry.peer && entry.peer->ss_family == AF_INET6)
+	{
+		const struct sockaddr_in6* peer = reinterpret_cast<const struct sockaddr_in6*>(entry.peer);
+		record.addressFamily = 6;
+		std::memcpy(record.address, &peer->sin6_addr, sizeof(peer->sin6_addr));
+		record.port = ntohs(peer->sin6_port);
+	}
+
+	_buffer.append(reinterpret_cast<const char*>(&record), sizeof(record));
+	if (_buffer.size() >= _bufferSize)
+		flush();
+}
+
+void AccessLog::tick(std::chrono::steady_clock::time_point now)
+{
+	if (!_buffer.empty() && now - _lastFlush >= _flushInterval)
+		flush();
+}
+
+void AccessLog::flush()
+{
+	_lastFlush = std::chrono::steady_clock::now();
+	if (!_file || _buffer.empty())
+		return;
+
+	std::lock_guard<std::mutex> guard(_file->lock);
+	if (_file->maxSize > 0 && _file->size > sizeof(FileHeader) && _file->size + _buffer.size() > _file->maxSize)
+		_file->rotate();
+
+	// A file we have not written to yet knows none of our strings
+	std::string definitions;
+	if (_fileEpoch != _file->epoch)
+	{
+		for (size_t id = 0; id < _strings.size(); id++)
+			appendString(definitions, static_cast<uint32_t>(id), _strings[id]);
+		_fileEpoch = _file->epoch;
+	}
+
+	struct iovec iov[2] = {
+		{definitions.data(), definitions.size()},
+		{_buffer.data(), _buffer.size()}
+	};
+	size_t total = definitions.size() + _buffer.size();
+	ssize_t written = (_file->fd >= 0) ? writev(_file->fd, iov, 2) : -1;
+	if (written >= 0)
+		_file->size += static_cast<uint64_t>(written);
+	if (written != static_cast<ssize_t>(total) && !_file->failed)
+	{
+		_file->failed = true;
+		LOG_ERROR("Access log write to " << _file->path << " failed, records lost: "
+			<< (written < 0 ? strerror(errno) : "short write"));
+	}
+	_buffer.clear();
+}
@@ -0,0 +1,266 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   BufferChain.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/09 11:04:52 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/09 11:04:52 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "BufferChain.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
+
+FileHandle::FileHandle(int fd) : _fd(fd) {}
+
+FileHandle::~FileHandle()
+{
+	if (_fd >= 0)
+		close(_fd);
+}
+
+int FileHandle::getFd() const
+{
+	return _fd;
+}
+
+const char* BufferChain::Segment::data() const
+{
+	if (kind == OWNED)
+		return owned.data();
+	return blob->data() + offset;
+}
+
+BufferChain::BufferChain(std::string data)
+{
+	append(std::move(data));
+}
+
+BufferChain::BufferChain(const char* data)
+{
+	append(std::string(data));
+}
+
+void BufferChain::append(std::string data)
+{
+	if (data.empty())
+		return;
+	Segment segment;
+	segment.kind = OWNED;
+	segment.length = data.size();
+	segment.owned = std::move(data);
+	_size += segment.length;
+	_segments.push_back(std::move(segment));
+}
+
+void BufferChain::append(std::shared_ptr<const std::string> blob)
+{
+	size_t length = blob->size();
+	append(std::move(blob), 0, length);
+}
+
+void BufferChain::append(std::shared_ptr<const std::string> blob, size_t offset, size_t length)
+{
+	if (length == 0)
+		return;
+	if (offset + length > blob->size())
+		throw std::out_of_range("BufferChain: blob slice out of range");
+	Segment segment;
+	segment.kind = SHARED;
+	segment.blob = std::move(blob);
+	segment.offset = offset;
+	segment.length = length;
+	_size += length;
+	_segments.push_back(std::move(segment));
+}
+
+void BufferChain::append(std::shared_ptr<FileHandle> file, uint64_t offset, uint64_t length)
+{
+	if (length == 0)
+		return;
+	Segment segment;
+	segment.kind = FILE;
+	segment.file = std::move(file);
+	segment.offset = offset;
+	segment.length = length;
+	_size += segment.length;
+	_segments.push_back(std::move(segment));
+}
+
+void BufferChain::append(BufferChain&& other)
+{
+	if (!other._segments.empty() && other._frontOffset)
+	{
+		// Drop the already written prefix so the moved segments start at a clean boundary
+		Segment& front = other._segments.front();
+		if (front.kind == OWNED)
+			front.owned.erase(0, other._frontOffset);
+		else
+			front.offset += other._frontOffset;
+		front.length -= other._frontOffset;
+	}
+	for (Segment& segment : other._segments)
+		_segments.push_back(std::move(segment));
+	_size += other._size;
+	other._segments.clear();
+	other._frontOffset = 0;
+	other._size = 0;
+}
+
+void BufferChain::insert(size_t position, std::string data)
+{
+	if (data.empty())
+		return;
+	if (position > _size)
+		throw std::out_of_range("BufferChain: insert position out of range");
+
+	size_t dataLength = data.size();
+	position += _frontOffset;
+	for (auto it = _segments.begin(); it != _segments.end(); ++it)
+	{
+		if (position > it->length)
+		{
+			position -= it->length;
+			continue;
+		}
+
+		if (it->kind == OWNED)
+		{
+			it->owned.insert(position, data);
+			it->length += dataLength;
+			_size += dataLength;
+			return;
+		}
+
+		Segment inserted;
+		inserted.kind = OWNED;
+		inserted.length = dataLength;
+		inserted.owned = std::move(data);
+		_size += dataLength;
+		if (position == 0)
+		{
+			_segments.insert(it, std::move(inserted));
+			return;
+		}
+
+		// Shared blobs and files are never modified, split around the new bytes instead
+		Segment tail = *it;
+		tail.offset += position;
+		tail.length -= position;
+		it->length = position;
+		it = _segments.insert(it + 1, std::move(inserted));
+		if (tail.length > 0)
+			_segments.insert(it + 1, std::move(tail));
+		return;
+	}
+	append(std::move(data));
+}
+
+std::string_view BufferChain::head() const
+{
+	if (_segments.empty() || _segments.front().kind == FILE)
+		return {};
+	const Segment& front = _segments.front();
+	return std::string_view(front.data() + _frontOffset, front.length - _frontOffset);
+}
+
+ssize_t BufferChain::writeTo(int fd)
+{
+	if (_segments.empty())
+		return 0;
+	if (_segments.front().kind == FILE)
+		return writeFile(fd, _segments.front());
+
+	struct iovec iov[64];
+	int count = 0;
+	size_t offset = static_cast<size_t>(_frontOffset);
+	for (auto it = _segments.begin(); it != _segments.end() && it->kind != FILE && count < 64; ++it, offset = 0)
+	{
+		iov[count].iov_base = const_cast<char*>(it->data()) + offset;
+		iov[count].iov_len = it->length - offset;
+		count++;
+	}
+
+	ssize_t written = writev(fd, iov, count);
+	if (written > 0)
+		consume(written);
+	return written;
+}
+
+/**
+ * The file goes from the page cache to the socket with sendfile, the body never
+ * enters user space. Elsewhere a bounded pread buffer is used, memory stays constant either way.
+ */
+ssize_t BufferChain::writeFile(int fd, const Segment& segment)
+{
+	size_t chunk = static_cast<size_t>(std::min<uint64_t>(sendfileChunk, segment.length - _frontOffset));
+	off_t position = static_cast<off_t>(segment.offset + _frontOffset);
+
+#ifdef __linux__
+	ssize_t sent = sendfile(fd, segment.file->getFd(), &position, chunk);
+	if (sent > 0)
+	{
+		consume(sent);
+		return sent;
+	}
+	if (sent == 0)
+	{
+		errno = EIO; // the file shrank under us, the promised length cannot be delivered
+		return -1;
+	}
+	if (errno != EINVAL && errno != ENOSYS)
+		return -1;
+	// The file type does not support sendfile, fall back to copying
+#endif
+
+	char buffer[64 * 1024];
+	ssize_t bytesRead = pread(segment.file->getFd(), buffer, std::min(chunk, sizeof(buffer)), position);
+	if (bytesRead <= 0)
+	{
+		if (bytesRead == 0)
+			errno = EIO; // the file shrank under us, the promised length cannot be delivered
+		return -1;
+	}
+
+	ssize_t written = write(fd, buffer, bytesRead);
+	if (written > 0)
+		consume(written);
+	return written;
+}
+
+void BufferChain::consume(uint64_t bytes)
+{
+	bytes = std::min(bytes, _size);
+	_size -= bytes;
+	while (bytes > 0)
+	{
+		uint64_t available = _segments.front().length - _frontOffset;
+		if (bytes < available)
+		{
+			_frontOffset += bytes;
+			return;
+		}
+		bytes -= available;
+		_segments.pop_front();
+		_frontOffset = 0;
+	}
+}
+
+bool BufferChain::empty() const
+{
+	return _size == 0;
+}
+
+uint64_t BufferChain::size() const
+{
+	return _size;
+}
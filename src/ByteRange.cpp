@@ -0,0 +1,114 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ByteRange.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/25 14:20:37 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/25 14:20:37 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ByteRange.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+	std::string_view trimSpaces(std::string_view value)
+	{
+		size_t first = value.find_first_not_of(" \t");
+		if (first == std::string_view::npos)
+			return {};
+		size_t last = value.find_last_not_of(" \t");
+		return value.substr(first, last - first + 1);
+	}
+
+	// Digits only, no sign or spaces, and small enough for 64 bits
+	bool parseNumber(std::string_view text, uint64_t& value)
+	{
+		if (text.empty())
+			return false;
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		return error == std::errc() && end == text.data() + text.size();
+	}
+}
+
+/**
+ * "bytes=0-99", "bytes=500-", "bytes=-500" and comma separated lists of them.
+ * A syntax error anywhere makes the whole header ignored, a range that starts
+ * past the end is dropped, and if none is left the request is unsatisfiable.
+ */
+byterange::Result byterange::parse(std::string_view header, uint64_t size, std::vector<Range>& ranges)
+{
+	ranges.clear();
+	header = trimSpaces(header);
+	if (header.size() < 6 || header.substr(0, 6) != "bytes=")
+		return IGNORED;
+	header.remove_prefix(6);
+
+	bool any = false;
+	while (!header.empty())
+	{
+		size_t comma = std::min(header.find(','), header.size());
+		std::string_view spec = trimSpaces(header.substr(0, comma));
+		header.remove_prefix(std::min(comma + 1, header.size()));
+		if (spec.empty())
+			continue;
+		any = true;
+
+		size_t dash = spec.find('-');
+		if (dash == std::string_view::npos)
+			return IGNORED;
+		std::string_view firstText = spec.substr(0, dash);
+		std::string_view lastText = spec.substr(dash + 1);
+		uint64_t first = 0;
+		uint64_t last = 0;
+		if (firstText.empty())
+		{
+			// Suffix range, the final N bytes
+			if (!parseNumber(lastText, last))
+				return IGNORED;
+			if (last == 0 || size == 0)
+				continue;
+			first = size - std::min(last, size);
+			last = size - 1;
+		}
+		else
+		{
+			if (!parseNumber(firstText, first))
+				return IGNORED;
+			if (lastText.empty())
+				last = UINT64_MAX;
+			else if (!parseNumber(lastText, last) || last < first)
+				return IGNORED;
+			if (first >= size)
+				continue;
+			last = std::min(last, size - 1);
+		}
+		ranges.push_back({first, last - first + 1});
+	}
+	if (!any)
+		return IGNORED;
+	if (ranges.empty())
+		return UNSATISFIABLE;
+
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.first < b.first; });
+	size_t merged = 0;
+	for (size_t i = 1; i < ranges.size(); i++)
+	{
+		Range& current = ranges[merged];
+		if (ranges[i].first <= current.first + current.length)
+			current.length = std::max(current.first + current.length, ranges[i].first + ranges[i].length) - current.first;
+		else
+			ranges[++merged] = ranges[i];
+	}
+	ranges.resize(merged + 1);
+	if (ranges.size() > maxRanges)
+	{
+		ranges.clear();
+		return IGNORED;
+	}
+	return SATISFIABLE;
+}
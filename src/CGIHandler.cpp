@@ -14,10 +14,6 @@
 
 volatile sig_atomic_t CGIHandler::timeoutOccurred = 0;
 
-CGIHandler::CGIHandler(const std::unordered_multimap<std::string, std::string>& serverConfig,
-					   const std::map<std::string, CGIConfig>& cgiConfig)
-	: _serverConfig(serverConfig), _cgiConfig(cgiConfig) {}
-
 CGIHandler::CGIHandler(const std::unordered_multimap<std::string, std::string>& serverConfig) : _serverConfig(serverConfig) {}
 
 void CGIHandler::handleTimeout(int signal)
@@ -28,48 +24,21 @@ void CGIHandler::handleTimeout(int signal)
 	}
 }
 
-const CGIHandler::CGIConfig& CGIHandler::getCGIConfig(const std::string& requestPath) const
+std::string CGIHandler::executeCGI(const CGIConfig& cgiConfig, const std::string& scriptPath, const std::string& method,
+	const std::string& queryString, const HTTPRequest& request)
 {
-	std::string bestMatch = "";
-	for (const auto& [location, config] : _cgiConfig)
+	// A spooled body goes to the script as its stdin file, only one in memory is written to a pipe
+	int bodyFd = request.getBodyFile();
+	std::string_view requestBody = (bodyFd >= 0) ? std::string_view() : request.getBody();
+	if (bodyFd >= 0 && lseek(bodyFd, 0, SEEK_SET) < 0)
 	{
-		if (requestPath.find(location) == 0)
-		{
-			if (location.length() > bestMatch.length())
-			{
-				bestMatch = location;
-			}
-		}
-	}
-	if (!bestMatch.empty())
-	{
-		return _cgiConfig.at(bestMatch);
+		return "500 Internal Server Error";
 	}
-	static const CGIConfig defaultConfig;
-	return defaultConfig;
-}
 
-const std::map<std::string, CGIHandler::CGIConfig>& CGIHandler::getCGIConfigs() const
-{
-	return _cgiConfig;
-}
-
-void CGIHandler::setCGIConfig(const std::map<std::string, CGIConfig>& cgiConfig)
-{
-	_cgiConfig = cgiConfig;
-}
-
-std::string CGIHandler::executeCGI(const std::string& scriptPath, const std::string& method,
-	const std::string& queryString, const std::string& requestBody)
-{
 	signal(SIGALRM, handleTimeout);
 	timeoutOccurred = 0;
 	alarm(5);
 
-	std::string location = scriptPath.substr(0, scriptPath.rfind('/'));
-	if (location.empty()) location = "/";
-	const CGIConfig& cgiConfig = getCGIConfig(location);
-
 	std::string cleanScriptPath = scriptPath.substr(0, scriptPath.find('?'));
 
 	std::string rootDir = "./www";
@@ -96,7 +65,7 @@ std::string CGIHandler::executeCGI(const std::string& scriptPath, const std::str
 		close(pipeToChild[1]);
 		close(pipeFromChild[0]);
 
-		if (dup2(pipeToChild[0], STDIN_FILENO) == -1 || dup2(pipeFromChild[1], STDOUT_FILENO) == -1)
+		if (dup2(bodyFd >= 0 ? bodyFd : pipeToChild[0], STDIN_FILENO) == -1 || dup2(pipeFromChild[1], STDOUT_FILENO) == -1)
 		{
 			exit(1);
 		}
@@ -115,7 +84,7 @@ std::string CGIHandler::executeCGI(const std::string& scriptPath, const std::str
 		}
 		setenv("QUERY_STRING", queryStringEnv.c_str(), 1);
 
-		setenv("CONTENT_LENGTH", std::to_string(requestBody.size()).c_str(), 1);
+		setenv("CONTENT_LENGTH", std::to_string(request.getBodySize()).c_str(), 1);
 
 		std::string contentType = "application/x-www-form-urlencoded";
 		setenv("CONTENT_TYPE", contentType.c_str(), 1);
@@ -175,7 +144,7 @@ std::string CGIHandler::executeCGI(const std::string& scriptPath, const std::str
 
 	if (method == "POST" && !requestBody.empty())
 	{
-		write(pipeToChild[1], requestBody.c_str(), requestBody.size());
+		write(pipeToChild[1], requestBody.data(), requestBody.size());
 	}
 	close(pipeToChild[1]);
 
@@ -0,0 +1,223 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/02 18:12:03 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/02 18:12:03 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+std::unique_ptr<EventLoop> EventLoop::create(const std::string& backend)
+{
+#ifdef __linux__
+	if (backend.empty() || backend == "epoll")
+	{
+		return std::make_unique<EpollEventLoop>();
+	}
+#endif
+	if (!backend.empty() && backend != "poll")
+	{
+		LOG_WARN("Unknown event_backend '" << backend << "', falling back to poll");
+	}
+	return std::make_unique<PollEventLoop>();
+}
+
+// ------------------------------------------------------------------------
+// poll() backend
+// ------------------------------------------------------------------------
+static short toPollEvents(uint32_t interest)
+{
+	short events = 0;
+	if (interest & EventLoop::READ)
+		events |= POLLIN;
+	if (interest & EventLoop::WRITE)
+		events |= POLLOUT;
+	return events;
+}
+
+bool PollEventLoop::add(int fd, uint32_t interest, void* data)
+{
+	if (_slots.count(fd))
+	{
+		LOG_WARN("FD already in poll list: " << fd);
+		return false;
+	}
+
+	struct pollfd pfd{};
+	pfd.fd = fd;
+	pfd.events = toPollEvents(interest);
+	_slots[fd] = _pollFds.size();
+	_pollFds.push_back(pfd);
+	_data.push_back(data);
+	return true;
+}
+
+bool PollEventLoop::modify(int fd, uint32_t interest, void* data)
+{
+	auto it = _slots.find(fd);
+	if (it == _slots.end())
+		return false;
+
+	_pollFds[it->second].events = toPollEvents(interest);
+	_data[it->second] = data;
+	return true;
+}
+
+/**
+ * Swap-removes the slot so the array stays dense without shifting every entry
+ * behind it, only the moved fd needs its index updated.
+ */
+void PollEventLoop::remove(int fd)
+{
+	auto it = _slots.find(fd);
+	if (it == _slots.end())
+		return;
+
+	size_t slot = it->second;
+	size_t last = _pollFds.size() - 1;
+	if (slot != last)
+	{
+		_pollFds[slot] = _pollFds[last];
+		_data[slot] = _data[last];
+		_slots[_pollFds[slot].fd] = slot;
+	}
+	_pollFds.pop_back();
+	_data.pop_back();
+	_slots.erase(it);
+}
+
+int PollEventLoop::wait(std::vector<Event>& events, int timeoutMs)
+{
+	events.clear();
+	int ready = poll(_pollFds.data(), _pollFds.size(), timeoutMs);
+	if (ready <= 0)
+		return (ready < 0 && errno == EINTR) ? 0 : ready;
+
+	for (size_t i = 0; i < _pollFds.size() && static_cast<int>(events.size()) < ready; ++i)
+	{
+		short revents = _pollFds[i].revents;
+		if (!revents)
+			continue;
+
+		uint32_t mask = 0;
+		if (revents & POLLIN)
+			mask |= READABLE;
+		if (revents & POLLOUT)
+			mask |= WRITABLE;
+		if (revents & POLLHUP)
+			mask |= HANGUP;
+		if (revents & (POLLERR | POLLNVAL))
+			mask |= ERROR;
+		events.push_back({_data[i], mask});
+	}
+	return events.size();
+}
+
+const char* PollEventLoop::name() const
+{
+	return "poll";
+}
+
+// ------------------------------------------------------------------------
+// epoll backend (Linux default)
+// ------------------------------------------------------------------------
+#ifdef __linux__
+EpollEventLoop::EpollEventLoop() : _epollFd(epoll_create1(EPOLL_CLOEXEC)), _buffer(256)
+{
+	if (_epollFd < 0)
+	{
+		throw std::runtime_error(std::string("Failed to create epoll instance: ") + strerror(errno));
+	}
+}
+
+EpollEventLoop::~EpollEventLoop()
+{
+	close(_epollFd);
+}
+
+static uint32_t toEpollEvents(uint32_t interest)
+{
+	uint32_t events = 0;
+	if (interest & EventLoop::READ)
+		events |= EPOLLIN;
+	if (interest & EventLoop::WRITE)
+		events |= EPOLLOUT;
+	if (interest & EventLoop::EDGE)
+		events |= EPOLLET;
+	return events;
+}
+
+bool EpollEventLoop::add(int fd, uint32_t interest, void* data)
+{
+	epoll_event ev{};
+	ev.events = toEpollEvents(interest);
+	ev.data.ptr = data;
+	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+	{
+		LOG_ERROR("epoll_ctl ADD failed for fd " << fd << " (" << strerror(errno) << ")");
+		return false;
+	}
+	return true;
+}
+
+bool EpollEventLoop::modify(int fd, uint32_t interest, void* data)
+{
+	epoll_event ev{};
+	ev.events = toEpollEvents(interest);
+	ev.data.ptr = data;
+	if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+	{
+		LOG_ERROR("epoll_ctl MOD failed for fd " << fd << " (" << strerror(errno) << ")");
+		return false;
+	}
+	return true;
+}
+
+void EpollEventLoop::remove(int fd)
+{
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int EpollEventLoop::wait(std::vector<Event>& events, int timeoutMs)
+{
+	events.clear();
+	int ready = epoll_wait(_epollFd, _buffer.data(), _buffer.size(), timeoutMs);
+	if (ready <= 0)
+		return (ready < 0 && errno == EINTR) ? 0 : ready;
+
+	for (int i = 0; i < ready; ++i)
+	{
+		uint32_t revents = _buffer[i].events;
+		uint32_t mask = 0;
+		if (revents & EPOLLIN)
+			mask |= READABLE;
+		if (revents & EPOLLOUT)
+			mask |= WRITABLE;
+		if (revents & EPOLLHUP)
+			mask |= HANGUP;
+		if (revents & EPOLLERR)
+			mask |= ERROR;
+		events.push_back({_buffer[i].data.ptr, mask});
+	}
+
+	// A full batch means more fds are probably ready, grow so the next wait drains them in one call
+	if (static_cast<size_t>(ready) == _buffer.size())
+		_buffer.resize(_buffer.size() * 2);
+	return ready;
+}
+
+const char* EpollEventLoop::name() const
+{
+	return "epoll";
+}
+#endif
@@ -0,0 +1,366 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileCache.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/11 16:24:09 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/11 16:24:09 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FileCache.hpp"
+#include "Logger.hpp"
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/inotify.h>
+#endif
+
+// "./www/html//index.html" and "www/html/index.html" must hit the same entry and the same watch
+static std::string normalize(const std::string& path)
+{
+	std::string normal = std::filesystem::path(path).lexically_normal().string();
+	if (normal.size() > 1 && normal.back() == '/')
+		normal.pop_back();
+	return normal;
+}
+
+FileCache& FileCache::instance()
+{
+	static FileCache cache;
+	return cache;
+}
+
+FileCache::FileCache()
+{
+#ifdef __linux__
+	_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotifyFd < 0)
+	{
+		LOG_WARN("inotify unavailable (" << strerror(errno) << "), file cache disabled");
+	}
+#endif
+}
+
+void FileCache::configure(size_t maxSize, size_t maxEntrySize, bool logStats)
+{
+	size_t current = _maxSize.load();
+	while (maxSize > current && !_maxSize.compare_exchange_weak(current, maxSize))
+		;
+	current = _maxEntrySize.load();
+	while (maxEntrySize > current && !_maxEntrySize.compare_exchange_weak(current, maxEntrySize))
+		;
+	if (logStats)
+		_logStats = true;
+}
+
+FileCache::Shard& FileCache::shardFor(const std::string& key)
+{
+	return _shards[std::hash<std::string>()(key) % shardCount];
+}
+
+const FileCache::Shard& FileCache::shardFor(const std::string& key) const
+{
+	return _shards[std::hash<std::string>()(key) % shardCount];
+}
+
+std::shared_ptr<const FileCache::CachedFile> FileCache::lookup(const std::string& path)
+{
+	if (_maxSize.load(std::memory_order_relaxed) == 0)
+		return nullptr;
+
+	std::string key = normalize(path);
+	Shard& shard = shardFor(key);
+	std::shared_lock<std::shared_mutex> guard(shard.lock);
+	auto it = shard.entries.find(key);
+	if (it == shard.entries.end())
+	{
+		shard.misses.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	// Only a flag store under the shared lock, the CLOCK hand reads it when it needs room
+	it->second.referenced.store(true, std::memory_order_relaxed);
+	shard.hits.fetch_add(1, std::memory_order_relaxed);
+	return it->second.file;
+}
+
+bool FileCache::cacheable(const std::string& path, uint64_t fileSize) const
+{
+	size_t maxSize = _maxSize.load(std::memory_order_relaxed);
+	if (_inotifyFd.load(std::memory_order_relaxed) < 0 || maxSize == 0 || fileSize > _maxEntrySize.load(std::memory_order_relaxed)
+		|| fileSize > maxSize / shardCount)
+		return false;
+
+	// Without a watch nobody would tell us the file changed
+	const std::vector<std::string>* roots = _roots.load(std::memory_order_acquire);
+	if (!roots)
+		return false;
+	std::string key = normalize(path);
+	for (const std::string& root : *roots)
+	{
+		if (key.size() > root.size() && key.compare(0, root.size(), root) == 0 && key[root.size()] == '/')
+			return true;
+	}
+	return false;
+}
+
+uint64_t FileCache::generation(const std::string& path) const
+{
+	return shardFor(normalize(path)).generation.load(std::memory_order_acquire);
+}
+
+void FileCache::insert(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t generation)
+{
+	std::string key = normalize(path);
+	Shard& shard = shardFor(key);
+	size_t capacity = _maxSize.load(std::memory_order_relaxed) / shardCount;
+	size_t size = file->response->size();
+
+	std::unique_lock<std::shared_mutex> guard(shard.lock);
+	if (shard.generation.load(std::memory_order_relaxed) != generation || size > capacity)
+		return;
+
+	auto existing = shard.entries.find(key);
+	if (existing != shard.entries.end())
+		erase(shard, existing);
+	while (shard.bytes + size > capacity && evictOne(shard))
+		;
+
+	Entry& entry = shard.entries[key];
+	entry.file = std::move(file);
+	entry.clockPosition = shard.clock.insert(shard.hand, key); // just behind the hand, last to be examined
+	shard.bytes += size;
+}
+
+void FileCache::erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it)
+{
+	if (shard.hand == it->second.clockPosition)
+		++shard.hand;
+	shard.clock.erase(it->second.clockPosition);
+	shard.bytes -= it->second.file->response->size();
+	shard.entries.erase(it);
+}
+
+// Second chance: a referenced entry loses its flag and survives one more sweep
+bool FileCache::evictOne(Shard& shard)
+{
+	while (!shard.entries.empty())
+	{
+		if (shard.hand == shard.clock.end())
+			shard.hand = shard.clock.begin();
+
+		auto it = shard.entries.find(*shard.hand);
+		if (it->second.referenced.exchange(false, std::memory_order_relaxed))
+		{
+			++shard.hand;
+			continue;
+		}
+		erase(shard, it);
+		shard.evictions.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void FileCache::invalidate(const std::string& path)
+{
+	std::string key = normalize(path);
+	Shard& shard = shardFor(key);
+	std::unique_lock<std::shared_mutex> guard(shard.lock);
+	shard.generation.fetch_add(1, std::memory_order_release);
+	auto it = shard.entries.find(key);
+	if (it != shard.entries.end())
+	{
+		erase(shard, it);
+		shard.invalidations.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void FileCache::clear()
+{
+	for (Shard& shard : _shards)
+	{
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		shard.generation.fetch_add(1, std::memory_order_release);
+		shard.invalidations.fetch_add(shard.entries.size(), std::memory_order_relaxed);
+		shard.entries.clear();
+		shard.clock.clear();
+		shard.hand = shard.clock.end();
+		shard.bytes = 0;
+	}
+}
+
+FileCache::Stats FileCache::getStats() const
+{
+	Stats stats{};
+	for (const Shard& shard : _shards)
+	{
+		stats.hits += shard.hits.load(std::memory_order_relaxed);
+		stats.misses += shard.misses.load(std::memory_order_relaxed);
+		stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+		stats.invalidations += shard.invalidations.load(std::memory_order_relaxed);
+		std::shared_lock<std::shared_mutex> guard(shard.lock);
+		stats.entries += shard.entries.size();
+		stats.bytes += shard.bytes;
+	}
+	return stats;
+}
+
+void FileCache::logStats() const
+{
+	Stats stats = getStats();
+	LOG_INFO("File cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+		<< stats.evictions << " evictions, " << stats.invalidations << " invalidations, "
+		<< stats.entries << " entries, " << stats.bytes << " bytes");
+}
+
+/**
+ * Registers a root directory and its whole subtree. The watcher thread starts with
+ * the first root, later roots are picked up by the same thread.
+ */
+void FileCache::watch(const std::string& directory)
+{
+#ifdef __linux__
+	if (_inotifyFd.load(std::memory_order_relaxed) < 0)
+		return;
+
+	std::string root = normalize(directory);
+	std::error_code ec;
+	if (!std::filesystem::is_directory(root, ec))
+		return;
+
+	{
+		std::unique_lock<std::shared_mutex> guard(_watchLock);
+		const std::vector<std::string>* current = _roots.load(std::memory_order_relaxed);
+		auto roots = std::make_unique<std::vector<std::string>>(current ? *current : std::vector<std::string>());
+		for (const std::string& known : *roots)
+		{
+			if (known == root)
+				return;
+		}
+		roots->push_back(root);
+		// Readers may still be walking the old set, so it stays allocated
+		_rootSets.push_back(std::move(roots));
+		_roots.store(_rootSets.back().get(), std::memory_order_release);
+	}
+	addWatchTree(root);
+
+	std::unique_lock<std::shared_mutex> guard(_watchLock);
+	if (!_watchThreadStarted)
+	{
+		_watchThreadStarted = true;
+		std::thread(&FileCache::watchLoop, this).detach();
+	}
+#else
+	(void)directory;
+#endif
+}
+
+void FileCache::addWatchTree(const std::string& directory)
+{
+#ifdef __linux__
+	const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+		| IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+	std::vector<std::string> directories = {directory};
+	std::error_code ec;
+	for (std::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (it->is_directory(ec))
+			directories.push_back(normalize(it->path().string()));
+	}
+
+	std::unique_lock<std::shared_mutex> guard(_watchLock);
+	for (const std::string& dir : directories)
+	{
+		int wd = inotify_add_watch(_inotifyFd, dir.c_str(), mask);
+		if (wd < 0)
+		{
+			LOG_WARN("Cannot watch " << dir << " for the file cache: " << strerror(errno));
+			continue;
+		}
+		_watches[wd] = dir;
+	}
+#else
+	(void)directory;
+#endif
+}
+
+void FileCache::watchLoop()
+{
+#ifdef __linux__
+	alignas(struct inotify_event) char buffer[16 * 1024];
+	auto lastStats = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		struct pollfd pfd = {_inotifyFd, POLLIN, 0};
+		poll(&pfd, 1, 1000);
+
+		if (_logStats.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() - lastStats > std::chrono::seconds(60))
+		{
+			lastStats = std::chrono::steady_clock::now();
+			logStats();
+		}
+
+		ssize_t length;
+		while ((length = read(_inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* ptr = buffer; ptr < buffer + length; )
+			{
+				const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+				ptr += sizeof(struct inotify_event) + event->len;
+
+				// Lost events, nothing can be trusted any more
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					clear();
+					continue;
+				}
+
+				std::string directory;
+				{
+					std::unique_lock<std::shared_mutex> guard(_watchLock);
+					auto it = _watches.find(event->wd);
+					if (it == _watches.end())
+						continue;
+					directory = it->second;
+					if (event->mask & IN_IGNORED)
+						_watches.erase(it);
+				}
+
+				if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+				{
+					clear();
+					continue;
+				}
+				if (event->len == 0)
+					continue;
+
+				std::string path = directory + "/" + event->name;
+				if (!(event->mask & IN_ISDIR))
+				{
+					invalidate(path);
+				}
+				else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					addWatchTree(path);
+				}
+				else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+				{
+					// Cheaper than tracking which entries lived under the directory
+					clear();
+				}
+			}
+		}
+	}
+#endif
+}
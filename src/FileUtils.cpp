@@ -13,7 +13,6 @@
 #include "FileUtils.hpp"
 #include "HTTPResponse.hpp"
 
-#include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
@@ -22,8 +21,10 @@
 #include <unistd.h>
 #include <filesystem>
 #include <sstream>
+#include <fcntl.h>
+#include <cerrno>
 
-std::pair<std::vector<char>, std::string> FileUtils::readFile(const std::string& filePath)
+std::pair<std::string, std::string> FileUtils::readFile(const std::string& filePath)
 {
 
 	if (!std::filesystem::exists(filePath))
@@ -34,30 +35,46 @@ std::pair<std::vector<char>, std::string> FileUtils::readFile(const std::string&
 	std::ifstream file(filePath, std::ios::binary);
 	if (!file.is_open())
 	{
-		std::cout << RED("[ERROR] Failed to open file: " << filePath) << std::endl;
+		LOG_ERROR("Failed to open file: " << filePath);
 		return {{}, ""};
 	}
 
 	std::uintmax_t fileSize = std::filesystem::file_size(filePath);
-	std::vector<char> fileContent(fileSize);
+	std::string fileContent(fileSize, '\0');
 
 	if (!file.read(fileContent.data(), fileSize))
 	{
-		std::cout << RED("[ERROR] Failed to read file content: " << filePath) << std::endl;
+		LOG_ERROR("Failed to read file content: " << filePath);
 		file.close();
 		return {{}, ""};
 	}
 
 	file.close();
-	return {fileContent, HTTPResponse::getContentType(filePath)};
+	return {std::move(fileContent), HTTPResponse::getContentType(filePath)};
 	}
 
-	bool FileUtils::writeFile(const std::string& filePath, const std::string& content)
+// pread until size bytes arrived, a short file means it changed since fstat
+bool FileUtils::readAll(int fd, char* buffer, size_t size)
+{
+	size_t done = 0;
+	while (done < size)
+	{
+		ssize_t bytesRead = pread(fd, buffer + done, size - done, done);
+		if (bytesRead < 0 && errno == EINTR)
+			continue;
+		if (bytesRead <= 0)
+			return false;
+		done += bytesRead;
+	}
+	return true;
+}
+
+	bool FileUtils::writeFile(const std::string& filePath, std::string_view content)
 	{
 	std::ofstream file(filePath, std::ios::binary);
 	if (!file.is_open())
 	{
-		std::cerr << RED("[ERROR] Failed to open file for writing: " << filePath) << std::endl;
+		LOG_ERROR("Failed to open file for writing: " << filePath);
 		return false;
 	}
 	file.write(content.data(), content.size());
@@ -68,7 +85,7 @@ std::pair<std::vector<char>, std::string> FileUtils::readFile(const std::string&
 	bool FileUtils::createDirectoryIfNotExists(const std::string& dirPath)
 	{
 	try {
-		std::cout << BLUE("[INFO] Creating directory: " << dirPath) << std::endl;
+		LOG_DEBUG("Creating directory: " << dirPath);
 		if (!std::filesystem::exists(dirPath))
 		{
 			std::filesystem::create_directories(dirPath);
@@ -77,7 +94,7 @@ std::pair<std::vector<char>, std::string> FileUtils::readFile(const std::string&
 	}
 	catch (const std::filesystem::filesystem_error& e)
 	{
-		std::cerr << RED("[ERROR] Failed to create directory: " << e.what()) << std::endl;
+		LOG_ERROR("Failed to create directory: " << e.what());
 		return false;
 	}
 }
@@ -86,7 +103,7 @@ bool FileUtils::deleteFile(const std::string& filePath)
 {
 	if (!std::filesystem::is_regular_file(filePath))
 	{
-		std::cerr << YELLOW("[DELETE] File not found or not a regular file: " << filePath) << std::endl;
+		LOG_WARN("[DELETE] File not found or not a regular file: " << filePath);
 		return false;
 	}
 
@@ -94,18 +111,18 @@ bool FileUtils::deleteFile(const std::string& filePath)
 		bool result = std::filesystem::remove(filePath);
 		if (result)
 		{
-			std::cout << PINK("[DELETE] Successfully deleted file: " << filePath) << std::endl;
+			LOG_INFO("[DELETE] Successfully deleted file: " << filePath);
 		}
 		else
 		{
-			std::cerr << YELLOW("[DELETE] Failed to delete file: " << filePath) << std::endl;
+			LOG_WARN("[DELETE] Failed to delete file: " << filePath);
 		}
 		return result;
 
 	}
 	catch (const std::filesystem::filesystem_error& e)
 	{
-		std::cerr << RED("[DELETE] Filesystem error: " << e.what()) << std::endl;
+		LOG_ERROR("[DELETE] Filesystem error: " << e.what());
 		return false;
 	}
 }
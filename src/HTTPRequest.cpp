@@ -11,117 +11,198 @@
 /* ************************************************************************** */
 
 #include "HTTPRequest.hpp"
-#include <iostream>
+#include "Scan.hpp"
 #include <algorithm>
+#include <charconv>
+#include <cctype>
 
-
-HTTPRequest::HTTPRequest(const std::string& rawRequest)
+namespace
 {
-	this->rawRequest = rawRequest;
-	parseRequest(rawRequest);
-}
+	// Same order as HTTPRequest::Header
+	constexpr std::string_view knownHeaders[HTTPRequest::KNOWN_HEADER_COUNT] = {
+		"Host", "Content-Length", "Content-Type", "Transfer-Encoding", "Connection",
+		"Expect", "Range", "If-None-Match", "If-Modified-Since", "If-Range", "Accept-Encoding"
+	};
 
-void HTTPRequest::parseRequest(const std::string& rawRequest)
-{
-	std::istringstream requestStream(rawRequest);
-	requestStream >> method >> path >> version;
-
-	std::string line;
-	std::getline(requestStream, line);
+	bool equalsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](char x, char y) { return ::tolower(static_cast<unsigned char>(x)) == ::tolower(static_cast<unsigned char>(y)); });
+	}
 
-	while (std::getline(requestStream, line) && !line.empty())
+	// Next space separated token of the request line, like operator>> without the copy
+	std::string_view nextToken(std::string_view& line)
 	{
-		if (!line.empty() && line[line.size() - 1] == '\r')
-		{
-			line.erase(line.size() - 1);
-		}
-		if (line.empty())
-		{
-			continue;
-		}
+		size_t start = std::min(line.find_first_not_of(' '), line.size());
+		size_t end = std::min(line.find(' ', start), line.size());
+		std::string_view token = line.substr(start, end - start);
+		line.remove_prefix(end);
+		return token;
+	}
 
-		size_t colonPos = line.find(':');
-		if (colonPos != std::string::npos)
+	// Calls visit(name, value) for each field line until it returns false
+	template <typename Visit>
+	void forEachField(std::string_view fields, Visit visit)
+	{
+		while (!fields.empty())
 		{
-			std::string key = line.substr(0, colonPos);
-			std::string value = line.substr(colonPos + 1);
-			value.erase(0, value.find_first_not_of(" \t"));
-			headers[key] = value;
+			std::string_view line = scan::nextLine(fields);
+
+			size_t colon = line.find(':');
+			if (colon == std::string_view::npos)
+				continue;
+			std::string_view value = line.substr(colon + 1);
+			value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+			value = value.substr(0, value.find_last_not_of(" \t") + 1);
+			if (!visit(line.substr(0, colon), value))
+				return;
 		}
 	}
+}
 
-	size_t headerEnd = rawRequest.find("\r\n\r\n");
-	if (headerEnd != std::string::npos) {
-		body = rawRequest.substr(headerEnd + 4);
+HTTPRequest::HTTPRequest(std::string_view rawRequest)
+{
+	parseRequest(rawRequest);
+}
 
-		std::string contentLengthStr = getHeader("Content-Length");
-		if (!contentLengthStr.empty())
+void HTTPRequest::parseRequest(std::string_view rawRequest)
+{
+	_rawRequest = rawRequest;
+	size_t headerEnd = scan::findHeaderEnd(rawRequest);
+	std::string_view head = rawRequest.substr(0, headerEnd);
+
+	size_t lineEnd = scan::findLineEnd(head);
+	std::string_view requestLine = head.substr(0, lineEnd);
+	_method = nextToken(requestLine);
+	_path = nextToken(requestLine);
+	_version = nextToken(requestLine);
+
+	if (lineEnd != std::string_view::npos)
+		_fields = head.substr(lineEnd + 2);
+	// The first occurrence of a known header wins, a null view marks a slot still empty
+	forEachField(_fields, [this](std::string_view name, std::string_view value) {
+		for (size_t i = 0; i < KNOWN_HEADER_COUNT; i++)
 		{
-			size_t contentLength = std::stoul(contentLengthStr);
-			if (body.size() > contentLength)
+			if (_headers[i].data() == nullptr && equalsIgnoreCase(name, knownHeaders[i]))
 			{
-				body = body.substr(0, contentLength);
-			}
-			else if (body.size() < contentLength)
-			{
-				std::cerr << RED("[ERROR] Incomplete body: Expected " << contentLength
-						  << " bytes, got " << body.size() << " bytes") << std::endl;
-				body.clear();
+				_headers[i] = value;
+				break;
 			}
 		}
+		return true;
+	});
+
+	if (headerEnd == std::string_view::npos)
+	{
+		LOG_DEBUG("No body found in request");
+		return;
 	}
-	else
+	_body = rawRequest.substr(headerEnd + 4);
+	// A header section on its own, the body arrives separately through setBody()
+	if (_body.empty())
+		return;
+
+	std::string_view contentLengthStr = _headers[CONTENT_LENGTH];
+	if (!contentLengthStr.empty())
 	{
-		std::cout << YELLOW("[INFO] No body found in request") << std::endl;
+		size_t contentLength = 0;
+		auto [end, error] = std::from_chars(contentLengthStr.data(), contentLengthStr.data() + contentLengthStr.size(), contentLength);
+		if (error == std::errc() && _body.size() >= contentLength)
+		{
+			_body = _body.substr(0, contentLength);
+		}
+		else
+		{
+			LOG_ERROR("Incomplete body: Expected " << contentLengthStr
+					  << " bytes, got " << _body.size() << " bytes");
+			_body = {};
+		}
 	}
 }
 
-std::string HTTPRequest::getMethod() const
+std::string_view HTTPRequest::getMethod() const
 {
-	return method;
+	return _method;
 }
 
-std::string HTTPRequest::getPath() const
+std::string_view HTTPRequest::getPath() const
 {
-	return path;
+	return _path;
 }
 
-std::string HTTPRequest::getHeader(const std::string& key) const
+std::string_view HTTPRequest::getVersion() const
 {
-	auto it = headers.find(key);
-	return (it != headers.end()) ? it->second : "";
+	return _version;
 }
 
-std::string HTTPRequest::getBody() const
+std::string_view HTTPRequest::getHeader(Header header) const
 {
-	return body;
+	return _headers[header];
 }
 
-std::string HTTPRequest::getRawRequest() const
+// Known names are answered from their slot, anything else costs a scan of the header lines
+std::string_view HTTPRequest::getHeader(std::string_view name) const
 {
-	return rawRequest;
+	for (size_t i = 0; i < KNOWN_HEADER_COUNT; i++)
+	{
+		if (equalsIgnoreCase(name, knownHeaders[i]))
+			return _headers[i];
+	}
+
+	std::string_view found;
+	forEachField(_fields, [&](std::string_view fieldName, std::string_view value) {
+		if (!equalsIgnoreCase(fieldName, name))
+			return true;
+		found = value;
+		return false;
+	});
+	return found;
 }
 
-std::string HTTPRequest::getContentTypeFromHeaders(const std::string& fullRequest)
+std::string_view HTTPRequest::getBody() const
 {
-	size_t headersEnd = fullRequest.find("\r\n\r\n");
-	if (headersEnd == std::string::npos)
-	{
-		return "";
-	}
+	return _bodyHandle ? _bodyHandle->data() : _body;
+}
 
-	std::string headers = fullRequest.substr(0, headersEnd);
-	size_t contentTypePos = headers.find("Content-Type: ");
-	if (contentTypePos == std::string::npos)
-	{
-		return "";
-	}
+std::string_view HTTPRequest::getRawRequest() const
+{
+	return _rawRequest;
+}
 
-	size_t contentTypeEnd = headers.find("\r\n", contentTypePos);
-	if (contentTypeEnd == std::string::npos)
-	{
-		return "";
-	}
+void HTTPRequest::setBody(const RequestBody& body)
+{
+	_body = {};
+	_bodyHandle = &body;
+}
 
-	return headers.substr(contentTypePos + 14, contentTypeEnd - contentTypePos - 14);
+const RequestBody* HTTPRequest::getBodyHandle() const
+{
+	return _bodyHandle;
+}
+
+int HTTPRequest::getBodyFile() const
+{
+	return _bodyHandle ? _bodyHandle->getFd() : -1;
+}
+
+uint64_t HTTPRequest::getBodySize() const
+{
+	return _bodyHandle ? _bodyHandle->size() : _body.size();
+}
+
+void HTTPRequest::setTrailers(std::string_view trailers)
+{
+	_trailers = trailers;
+}
+
+std::string_view HTTPRequest::getTrailer(std::string_view name) const
+{
+	std::string_view found;
+	forEachField(_trailers, [&](std::string_view fieldName, std::string_view value) {
+		if (!equalsIgnoreCase(fieldName, name))
+			return true;
+		found = value;
+		return false;
+	});
+	return found;
 }
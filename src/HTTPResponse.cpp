@@ -16,26 +16,72 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <filesystem>
-#include <iostream>
 #include <vector>
 #include <optional>
+#include <ctime>
 
 
 //This initializes an HTTPResponse object with a given status code, content type, and body.
-HTTPResponse::HTTPResponse(int statusCode, const std::string& contentType, const std::string& body)
-	: statusCode(statusCode), contentType(contentType), body(body) {}
+HTTPResponse::HTTPResponse(int statusCode, const std::string& contentType, std::string body)
+	: statusCode(statusCode), contentType(contentType), body(std::move(body)) {}
 
-//Generates raw HTTP response
+//Status line and headers up to the blank line, the Connection header is added by the server once it knows whether to keep the socket open
+std::string HTTPResponse::generateHeaders(int statusCode, const std::string& contentType, uint64_t contentLength)
+{
+	std::string headers = "HTTP/1.1 " + std::to_string(statusCode) + "\r\n";
+	headers += "Content-Type: " + contentType + "\r\n";
+	headers += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+	headers += "\r\n";
+	return headers;
+}
+
+//Same for files, the Content-Type line comes precomputed from the MIME table and byte ranges are advertised
+std::string HTTPResponse::generateHeaders(int statusCode, const MimeType& contentType, uint64_t contentLength,
+	std::string_view extraHeaders)
+{
+	std::string headers = "HTTP/1.1 " + std::to_string(statusCode) + "\r\n";
+	headers += contentType.headerLine;
+	headers += extraHeaders;
+	headers += "Accept-Ranges: bytes\r\n";
+	headers += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+	headers += "\r\n";
+	return headers;
+}
+
+//IMF-fixdate as used by Last-Modified and If-Range, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string HTTPResponse::httpDate(time_t time)
+{
+	struct tm utc;
+	char buffer[32];
+	gmtime_r(&time, &utc);
+	size_t length = strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+	return std::string(buffer, length);
+}
+
+//Only the IMF-fixdate form, a date in an obsolete format is treated like a missing header
+bool HTTPResponse::parseHttpDate(std::string_view text, time_t& time)
+{
+	std::string date(text);
+	struct tm utc = {};
+	const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+	if (!end || *end != '\0')
+		return false;
+	time = timegm(&utc);
+	return true;
+}
+
+//Generates raw HTTP response as one string, fine for the small bodies built in memory
 std::string HTTPResponse::generateResponse() const
 {
-	std::ostringstream response;
-	response << "HTTP/1.1 " << statusCode << "\r\n"
-			 << "Content-Type: " << contentType << "\r\n"
-			 << "Content-Length: " << body.size() << "\r\n"
-			 << "Connection: close\r\n"
-			 << "\r\n"
-			 << body;
-	return response.str();
+	return generateHeaders(statusCode, contentType, body.size()) + body;
+}
+
+//Headers and body as separate segments, the body is moved in rather than copied behind the headers
+BufferChain HTTPResponse::generateChain() &&
+{
+	BufferChain response(generateHeaders(statusCode, contentType, body.size()));
+	response.append(std::move(body));
+	return response;
 }
 
 /** This function attempts to read an image file in binary mode and return its contents as a std::string.
@@ -47,7 +93,7 @@ std::optional<std::string> readImageFile(const std::string& path)
 	std::ifstream file(path, std::ios::binary);
 	if (!file.is_open())
 	{
-		std::cerr << YELLOW("[WARN] Could not open image: " << path) << std::endl;
+		LOG_WARN("Could not open image: " << path);
 		return std::nullopt;
 	}
 	// Move cursor to end to determine size
@@ -56,15 +102,15 @@ std::optional<std::string> readImageFile(const std::string& path)
 	// Move cursor back to the beginning
 	file.seekg(0, std::ios::beg);
 
-	// Allocate buffer and read file data
-	std::vector<char> buffer(size);
-	if (!file.read(buffer.data(), size))
+	// Read straight into the string that is returned, no intermediate buffer
+	std::string content(size, '\0');
+	if (!file.read(content.data(), size))
 	{
-		std::cerr << YELLOW("[WARN] Failed to read image: " << path) << std::endl;
+		LOG_WARN("Failed to read image: " << path);
 		return std::nullopt;
 	}
 
-	return std::string(buffer.data(), size);
+	return content;
 }
 
 //Attempts to serve an error page based on errorCode. Searches for an error page image in ./www/html/error_pages/
@@ -76,8 +122,6 @@ std::pair<std::string, std::string> HTTPResponse::getDefaultErrorPage(int errorC
 	const std::string imagePath = basePath + std::to_string(errorCode) + ".jpg";
 	const std::string defaultImagePath = basePath + "default.jpg";
 
-	std::cout << BLUE("[INFO] Serving error page for code: " << errorCode) << std::endl;
-
 	auto content = readImageFile(imagePath);
 	if (content)
 	{
@@ -90,8 +134,8 @@ std::pair<std::string, std::string> HTTPResponse::getDefaultErrorPage(int errorC
 		return {*defaultContent, "image/jpeg"};
 	}
 
-	std::cerr << RED("[ERROR] Missing default error image: " << defaultImagePath) << std::endl;
-	std::cout << YELLOW("[INFO] Returning text fallback for error " << errorCode) << std::endl;
+	LOG_ERROR("Missing default error image: " << defaultImagePath);
+	LOG_WARN("Returning text fallback for error " << errorCode);
 	return {"Error " + std::to_string(errorCode) + ": Missing error page.", "text/plain"};
 }
 
@@ -102,22 +146,5 @@ std::pair<std::string, std::string> HTTPResponse::getDefaultErrorPage(int errorC
  */
 std::string HTTPResponse::getContentType(const std::string& filePath)
 {
-	size_t dotPos = filePath.find_last_of(".");
-	if (dotPos == std::string::npos)
-	{
-		return "application/octet-stream"; //returns  generic binary data MIME type
-	}
-
-	std::string ext = filePath.substr(dotPos + 1);
-	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower); //changes .JPG to jpg
-
-	if (ext == "html" || ext == "htm") return "text/html";
-	if (ext == "css") return "text/css";
-	if (ext == "js") return "application/javascript";
-	if (ext == "txt") return "text/plain";
-	if (ext == "jpg" || ext == "jpeg") return "image/jpeg";
-	if (ext == "png") return "image/png";
-	if (ext == "ico") return "image/x-icon";
-
-	return "application/octet-stream";
+	return MimeTypes::instance().lookup(filePath).name;
 }
@@ -0,0 +1,160 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LocationRouter.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/21 09:12:48 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/21 09:12:48 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "LocationRouter.hpp"
+
+unsigned LocationConfig::methodBit(std::string_view method)
+{
+	if (method == "GET") return GET;
+	if (method == "HEAD") return HEAD;
+	if (method == "POST") return POST;
+	if (method == "PUT") return PUT;
+	if (method == "DELETE") return DELETE;
+	if (method == "OPTIONS") return OPTIONS;
+	if (method == "PATCH") return PATCH;
+	return OTHER;
+}
+
+// HEAD is a GET without the body, so a location that allows GET answers it too
+bool LocationConfig::allows(std::string_view method) const
+{
+	unsigned bit = methodBit(method);
+	if (bit == HEAD)
+		bit |= GET;
+	return (methods & bit) != 0;
+}
+
+LocationRouter::LocationRouter() : _nodes(1), _configs(1) {}
+
+LocationRouter::LocationRouter(const std::map<std::string, LocationDirectives>& locations)
+	: _nodes(1), _configs(1)
+{
+	std::vector<const LocationDirectives*> directives(1, nullptr);
+	for (const auto& [path, locationDirectives] : locations)
+	{
+		if (path.empty())
+			continue;
+		directives.push_back(&locationDirectives);
+		_configs.emplace_back();
+		_configs.back().path = path;
+		insert(path, static_cast<uint32_t>(_configs.size() - 1));
+	}
+	resolve(0, 0, directives);
+}
+
+void LocationRouter::insert(std::string_view path, uint32_t config)
+{
+	uint32_t node = 0;
+	size_t pos = 0;
+	while (pos < path.size())
+	{
+		size_t edge = _nodes[node].edges.find(path[pos]);
+		if (edge == std::string::npos)
+		{
+			Node leaf;
+			leaf.label = std::string(path.substr(pos));
+			leaf.config = config;
+			_nodes.push_back(std::move(leaf));
+			_nodes[node].edges += path[pos];
+			_nodes[node].children.push_back(static_cast<uint32_t>(_nodes.size() - 1));
+			return;
+		}
+
+		uint32_t child = _nodes[node].children[edge];
+		const std::string& label = _nodes[child].label;
+		size_t common = 1;
+		while (common < label.size() && pos + common < path.size() && label[common] == path[pos + common])
+			common++;
+
+		// The path leaves the label halfway, split the edge at that byte
+		if (common < label.size())
+		{
+			Node middle;
+			middle.label = label.substr(0, common);
+			middle.edges += label[common];
+			middle.children.push_back(child);
+			_nodes[child].label.erase(0, common);
+			_nodes.push_back(std::move(middle));
+			child = static_cast<uint32_t>(_nodes.size() - 1);
+			_nodes[node].children[edge] = child;
+		}
+		node = child;
+		pos += common;
+	}
+	_nodes[node].config = config;
+}
+
+// Depth first, so every location copies its nearest ancestor after that one is complete
+void LocationRouter::resolve(uint32_t node, uint32_t inherited, const std::vector<const LocationDirectives*>& directives)
+{
+	uint32_t config = _nodes[node].config;
+	if (config != 0)
+	{
+		LocationConfig& resolved = _configs[config];
+		std::string path = std::move(resolved.path);
+		resolved = _configs[inherited];
+		resolved.path = std::move(path);
+
+		const LocationDirectives& own = *directives[config];
+		if (own.methods)
+			resolved.methods = *own.methods;
+		if (own.root)
+		{
+			resolved.root = *own.root;
+			resolved.rootLocation = resolved.path;
+		}
+		if (own.autoindex)
+			resolved.autoindex = *own.autoindex;
+		if (own.redirect)
+			resolved.redirect = *own.redirect;
+		if (own.cgi)
+		{
+			resolved.cgiEnabled = true;
+			resolved.cgi = *own.cgi;
+		}
+		if (own.clientMaxBodySize)
+			resolved.clientMaxBodySize = own.clientMaxBodySize;
+		inherited = config;
+	}
+	for (uint32_t child : _nodes[node].children)
+		resolve(child, inherited, directives);
+}
+
+const LocationConfig& LocationRouter::match(std::string_view path) const
+{
+	const Node* node = &_nodes[0];
+	uint32_t best = 0;
+	size_t pos = 0;
+	while (pos < path.size())
+	{
+		size_t edge = node->edges.find(path[pos]);
+		if (edge == std::string::npos)
+			break;
+		node = &_nodes[node->children[edge]];
+		if (path.compare(pos, node->label.size(), node->label) != 0)
+			break;
+		pos += node->label.size();
+		if (node->config != 0)
+			best = node->config;
+	}
+	return _configs[best];
+}
+
+const std::vector<LocationConfig>& LocationRouter::getLocations() const
+{
+	return _configs;
+}
+
+size_t LocationRouter::getNodeCount() const
+{
+	return _nodes.size();
+}
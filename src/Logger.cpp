@@ -0,0 +1,300 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Logger.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/16 09:12:40 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/16 09:12:40 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Logger.hpp"
+#include "Colors.hpp"
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace
+{
+	constexpr size_t ringSize = 64 * 1024; // per thread, must be a power of two
+
+	struct RecordHeader
+	{
+		uint32_t length;
+		uint32_t level;
+	};
+
+	// Fixed-size streambuf, a longer line is truncated instead of allocating
+	class LineBuffer : public std::streambuf {
+		public:
+			LineBuffer() { reset(); }
+			void reset() { setp(_line, _line + sizeof(_line)); }
+			const char* data() const { return pbase(); }
+			size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+
+		private:
+			char _line[4096];
+	};
+
+	struct ThreadLine
+	{
+		LineBuffer buffer;
+		std::ostream stream{&buffer};
+	};
+
+	ThreadLine& threadLine()
+	{
+		static thread_local ThreadLine line;
+		return line;
+	}
+
+	void copyIn(char* ring, uint64_t position, const void* source, size_t length)
+	{
+		size_t offset = position & (ringSize - 1);
+		size_t first = std::min(length, ringSize - offset);
+		std::memcpy(ring + offset, source, first);
+		std::memcpy(ring, static_cast<const char*>(source) + first, length - first);
+	}
+
+	void copyOut(const char* ring, uint64_t position, void* destination, size_t length)
+	{
+		size_t offset = position & (ringSize - 1);
+		size_t first = std::min(length, ringSize - offset);
+		std::memcpy(destination, ring + offset, first);
+		std::memcpy(static_cast<char*>(destination) + first, ring, length - first);
+	}
+
+	void format(std::ostream& os, Logger::Level level, std::string_view line, bool colors)
+	{
+		static const char* const tags[] = {"[DEBUG] ", "[INFO] ", "[WARN] ", "[ERROR] "};
+		if (!colors)
+			os << tags[level] << line;
+		else if (level == Logger::DEBUG)
+			os << ITALIC(tags[level] << line);
+		else if (level == Logger::INFO)
+			os << BLUE(tags[level] << line);
+		else if (level == Logger::WARN)
+			os << YELLOW(tags[level] << line);
+		else
+			os << RED(tags[level] << line);
+		os << '\n';
+	}
+
+	void writeOut(int fd, std::ostringstream& batch)
+	{
+		std::string data = batch.str();
+		batch.str(std::string());
+		for (size_t written = 0; written < data.size(); )
+		{
+			ssize_t result = write(fd, data.data() + written, data.size() - written);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+				return;
+			written += static_cast<size_t>(result);
+		}
+	}
+}
+
+/**
+ * Single producer (the owning thread), single consumer (the writer).
+ * head and tail only ever grow, the index into data is taken modulo ringSize.
+ * A buffer whose thread ended is handed to the next new thread instead of being freed.
+ */
+struct Logger::ThreadBuffer
+{
+	alignas(64) std::atomic<uint64_t> head{0};
+	alignas(64) std::atomic<uint64_t> tail{0};
+	std::atomic<uint64_t> dropped{0};
+	std::atomic<bool> inUse{true};
+	ThreadBuffer* next = nullptr;
+	char data[ringSize];
+};
+
+std::atomic<int> Logger::_level{Logger::INFO};
+
+Logger& Logger::instance()
+{
+	// Never destroyed: detached threads may still log while statics are torn down
+	static Logger* logger = new Logger();
+	return *logger;
+}
+
+Logger::Logger()
+	: _stdoutColors(isatty(STDOUT_FILENO)), _stderrColors(isatty(STDERR_FILENO)), _pid(getpid())
+{
+	_writer = std::thread(&Logger::writerLoop, this);
+	std::atexit(&Logger::shutdown);
+}
+
+void Logger::shutdown()
+{
+	Logger& logger = instance();
+	if (getpid() != logger._pid || !logger._writer.joinable())
+		return;
+	logger._stop.store(true, std::memory_order_release);
+	logger._writer.join();
+}
+
+void Logger::setLevel(Level level)
+{
+	if (!_levelConfigured || level < _level.load())
+		_level.store(level);
+	_levelConfigured = true;
+}
+
+Logger::Level Logger::parseLevel(const std::string& name)
+{
+	if (name == "debug")
+		return DEBUG;
+	if (name == "info")
+		return INFO;
+	if (name == "warn")
+		return WARN;
+	if (name == "error")
+		return ERROR;
+	throw std::runtime_error("Invalid log_level: " + name);
+}
+
+std::ostream& Logger::stream()
+{
+	ThreadLine& line = threadLine();
+	line.buffer.reset();
+	line.stream.clear();
+	line.stream.flags(std::ios_base::dec | std::ios_base::skipws);
+	line.stream.precision(6);
+	return line.stream;
+}
+
+Logger::ThreadBuffer& Logger::threadBuffer()
+{
+	struct Owner
+	{
+		ThreadBuffer* buffer = nullptr;
+		~Owner()
+		{
+			if (buffer)
+				buffer->inUse.store(false, std::memory_order_release);
+		}
+	};
+	static thread_local Owner owner;
+	if (owner.buffer)
+		return *owner.buffer;
+
+	for (ThreadBuffer* buffer = _buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+	{
+		bool expected = false;
+		if (buffer->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+		{
+			owner.buffer = buffer;
+			return *buffer;
+		}
+	}
+
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->next = _buffers.load(std::memory_order_relaxed);
+	while (!_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+		;
+	owner.buffer = buffer;
+	return *buffer;
+}
+
+void Logger::commit(Level level)
+{
+	LineBuffer& line = threadLine().buffer;
+	ThreadBuffer& buffer = threadBuffer();
+	RecordHeader header = {static_cast<uint32_t>(line.size()), static_cast<uint32_t>(level)};
+	size_t needed = sizeof(header) + header.length;
+
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	uint64_t tail = buffer.tail.load(std::memory_order_acquire);
+	if (needed > ringSize - (head - tail))
+	{
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	copyIn(buffer.data, head, &header, sizeof(header));
+	copyIn(buffer.data, head + sizeof(header), line.data(), header.length);
+	buffer.head.store(head + needed, std::memory_order_release);
+}
+
+uint64_t Logger::droppedLines() const
+{
+	uint64_t dropped = 0;
+	for (ThreadBuffer* buffer = _buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+bool Logger::drain(std::ostream& out, std::ostream& err)
+{
+	static std::string line;
+	bool drained = false;
+	for (ThreadBuffer* buffer = _buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+	{
+		uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		while (tail != head)
+		{
+			RecordHeader header;
+			copyOut(buffer->data, tail, &header, sizeof(header));
+			line.resize(header.length);
+			copyOut(buffer->data, tail + sizeof(header), &line[0], header.length);
+			tail += sizeof(header) + header.length;
+
+			Level level = static_cast<Level>(header.level);
+			if (level >= WARN)
+				format(err, level, line, _stderrColors);
+			else
+				format(out, level, line, _stdoutColors);
+			drained = true;
+		}
+		buffer->tail.store(tail, std::memory_order_release);
+	}
+	return drained;
+}
+
+// Polls with a backoff instead of being woken, so logging never costs a syscall
+void Logger::writerLoop()
+{
+	std::ostringstream out;
+	std::ostringstream err;
+	uint64_t reported = 0;
+	std::chrono::milliseconds idle(1);
+
+	while (true)
+	{
+		bool stopping = _stop.load(std::memory_order_acquire);
+		bool drained = drain(out, err);
+
+		uint64_t dropped = droppedLines();
+		if (dropped != reported)
+		{
+			std::ostringstream notice;
+			notice << "Logger dropped " << dropped - reported << " lines";
+			format(err, WARN, notice.str(), _stderrColors);
+			reported = dropped;
+		}
+		writeOut(STDOUT_FILENO, out);
+		writeOut(STDERR_FILENO, err);
+
+		if (drained)
+		{
+			idle = std::chrono::milliseconds(1);
+			continue;
+		}
+		if (stopping)
+			break;
+		std::this_thread::sleep_for(idle);
+		idle = std::min(idle * 2, std::chrono::milliseconds(50));
+	}
+}
@@ -0,0 +1,310 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/18 10:31:06 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/18 10:31:06 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Metrics.hpp"
+#include "FileCache.hpp"
+#include <map>
+#include <array>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+	const char* const phaseNames[] = {
+		"accept_to_first_byte", "header_parse", "routing",
+		"handler_static", "handler_cgi", "handler_upload", "response_write"
+	};
+	const char* const classNames[] = {"other", "1xx", "2xx", "3xx", "4xx", "5xx"};
+
+	std::mutex& registryLock()
+	{
+		static std::mutex lock;
+		return lock;
+	}
+
+	std::vector<Metrics*>& registry()
+	{
+		static std::vector<Metrics*> shards;
+		return shards;
+	}
+
+	const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+	std::string escapeLabel(const std::string& value)
+	{
+		std::string escaped;
+		for (char c : value)
+		{
+			if (c == '\\' || c == '"')
+				escaped += '\\';
+			if (c == '\n')
+				escaped += "\\n";
+			else
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	std::string escapeJson(const std::string& value)
+	{
+		std::ostringstream escaped;
+		for (unsigned char c : value)
+		{
+			if (c == '\\' || c == '"')
+				escaped << '\\' << c;
+			else if (c < 0x20)
+				escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			else
+				escaped << c;
+		}
+		return escaped.str();
+	}
+}
+
+struct Metrics::Aggregate
+{
+	struct Phase
+	{
+		uint64_t buckets[Histogram::bucketCount] = {};
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t max = 0;
+
+		// Upper bound of the bucket holding the q-quantile, in nanoseconds
+		uint64_t quantile(double q) const
+		{
+			uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+			uint64_t seen = 0;
+			for (size_t i = 0; i < Histogram::bucketCount; i++)
+			{
+				seen += buckets[i];
+				if (seen >= target)
+					return std::min(Histogram::bucketUpperBound(i), max);
+			}
+			return max;
+		}
+	};
+
+	Phase phases[PHASE_COUNT];
+	uint64_t accepted = 0;
+	uint64_t active = 0;
+	std::map<std::pair<std::string, std::string>, std::array<uint64_t, 6>> requests;
+};
+
+size_t Metrics::Histogram::bucketOf(uint64_t value)
+{
+	if (value < 8)
+		return static_cast<size_t>(value);
+	unsigned exponent = 63 - __builtin_clzll(value);
+	size_t bucket = (exponent - 2) * 8 + ((value >> (exponent - 3)) & 7);
+	return std::min(bucket, bucketCount - 1);
+}
+
+uint64_t Metrics::Histogram::bucketUpperBound(size_t bucket)
+{
+	if (bucket < 8)
+		return bucket;
+	unsigned exponent = static_cast<unsigned>(bucket / 8 + 2);
+	return ((9 + bucket % 8) << (exponent - 3)) - 1;
+}
+
+void Metrics::Histogram::record(uint64_t nanoseconds)
+{
+	bump(_buckets[bucketOf(nanoseconds)]);
+	bump(_count);
+	bump(_sum, nanoseconds);
+	if (nanoseconds > _max.load(std::memory_order_relaxed))
+		_max.store(nanoseconds, std::memory_order_relaxed);
+}
+
+Metrics::Metrics()
+{
+	std::lock_guard<std::mutex> guard(registryLock());
+	registry().push_back(this);
+}
+
+Metrics::~Metrics()
+{
+	std::lock_guard<std::mutex> guard(registryLock());
+	std::vector<Metrics*>& shards = registry();
+	shards.erase(std::remove(shards.begin(), shards.end(), this), shards.end());
+}
+
+void Metrics::recordPhase(Phase phase, std::chrono::steady_clock::duration duration)
+{
+	int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	_phases[phase].record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0);
+}
+
+void Metrics::countRequest(std::string_view vhost, std::string_view location, int status)
+{
+	static thread_local std::string key;
+	key.assign(vhost).append(1, '\n').append(location);
+
+	auto it = _requests.find(key);
+	if (it == _requests.end())
+	{
+		// Labels come from the configuration, the cap only guards a scrape against an unexpected source
+		if (_requests.size() >= maxRequestSeries)
+			key.assign("other\n");
+		std::lock_guard<std::mutex> guard(_requestsLock);
+		it = _requests.try_emplace(key).first;
+	}
+	bump(it->second.byClass[(status >= 100 && status < 600) ? status / 100 : 0]);
+}
+
+void Metrics::connectionOpened()
+{
+	bump(_accepted);
+	bump(_active);
+}
+
+void Metrics::connectionClosed()
+{
+	_active.store(_active.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+Metrics::Aggregate Metrics::collect()
+{
+	Aggregate total;
+	std::lock_guard<std::mutex> guard(registryLock());
+	for (Metrics* shard : registry())
+	{
+		for (size_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			const Histogram& histogram = shard->_phases[phase];
+			Aggregate::Phase& sum = total.phases[phase];
+			for (size_t i = 0; i < Histogram::bucketCount; i++)
+				sum.buckets[i] += histogram._buckets[i].load(std::memory_order_relaxed);
+			sum.count += histogram._count.load(std::memory_order_relaxed);
+			sum.sum += histogram._sum.load(std::memory_order_relaxed);
+			sum.max = std::max(sum.max, histogram._max.load(std::memory_order_relaxed));
+		}
+		total.accepted += shard->_accepted.load(std::memory_order_relaxed);
+		total.active += shard->_active.load(std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> requestsGuard(shard->_requestsLock);
+		for (const auto& [key, counters] : shard->_requests)
+		{
+			size_t split = key.find('\n');
+			std::array<uint64_t, 6>& sum = total.requests[{key.substr(0, split), key.substr(split + 1)}];
+			for (size_t i = 0; i < 6; i++)
+				sum[i] += counters.byClass[i].load(std::memory_order_relaxed);
+		}
+	}
+	return total;
+}
+
+std::string Metrics::renderPrometheus()
+{
+	Aggregate total = collect();
+	FileCache::Stats cache = FileCache::instance().getStats();
+	std::ostringstream out;
+
+	out << "# HELP webserv_uptime_seconds Seconds since the server started.\n"
+		<< "# TYPE webserv_uptime_seconds gauge\n"
+		<< "webserv_uptime_seconds " << std::chrono::duration<double>(std::chrono::steady_clock::now() - processStart).count() << "\n"
+		<< "# HELP webserv_connections_accepted_total Client connections accepted.\n"
+		<< "# TYPE webserv_connections_accepted_total counter\n"
+		<< "webserv_connections_accepted_total " << total.accepted << "\n"
+		<< "# HELP webserv_connections_active Client connections currently open.\n"
+		<< "# TYPE webserv_connections_active gauge\n"
+		<< "webserv_connections_active " << total.active << "\n";
+
+	out << "# HELP webserv_requests_total Requests answered, by virtual host, location and status class.\n"
+		<< "# TYPE webserv_requests_total counter\n";
+	for (const auto& [key, counters] : total.requests)
+	{
+		for (size_t i = 0; i < 6; i++)
+		{
+			if (counters[i] == 0)
+				continue;
+			out << "webserv_requests_total{vhost=\"" << escapeLabel(key.first) << "\",location=\""
+				<< escapeLabel(key.second) << "\",status=\"" << classNames[i] << "\"} " << counters[i] << "\n";
+		}
+	}
+
+	// Exported at every power of two from about 1us to 69s, the fine buckets only feed the JSON quantiles
+	out << "# HELP webserv_phase_duration_seconds Time spent in each phase of a request.\n"
+		<< "# TYPE webserv_phase_duration_seconds histogram\n";
+	for (size_t phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		const Aggregate::Phase& histogram = total.phases[phase];
+		uint64_t cumulative = 0;
+		size_t bucket = 0;
+		for (unsigned exponent = 10; exponent <= 36; exponent++)
+		{
+			for (; bucket < (exponent - 2) * 8; bucket++)
+				cumulative += histogram.buckets[bucket];
+			out << "webserv_phase_duration_seconds_bucket{phase=\"" << phaseNames[phase] << "\",le=\""
+				<< static_cast<double>(1ULL << exponent) / 1e9 << "\"} " << cumulative << "\n";
+		}
+		out << "webserv_phase_duration_seconds_bucket{phase=\"" << phaseNames[phase] << "\",le=\"+Inf\"} " << histogram.count << "\n"
+			<< "webserv_phase_duration_seconds_sum{phase=\"" << phaseNames[phase] << "\"} " << histogram.sum / 1e9 << "\n"
+			<< "webserv_phase_duration_seconds_count{phase=\"" << phaseNames[phase] << "\"} " << histogram.count << "\n";
+	}
+
+	out << "# HELP webserv_file_cache_events_total Shared file cache lookups and removals.\n"
+		<< "# TYPE webserv_file_cache_events_total counter\n"
+		<< "webserv_file_cache_events_total{event=\"hit\"} " << cache.hits << "\n"
+		<< "webserv_file_cache_events_total{event=\"miss\"} " << cache.misses << "\n"
+		<< "webserv_file_cache_events_total{event=\"eviction\"} " << cache.evictions << "\n"
+		<< "webserv_file_cache_events_total{event=\"invalidation\"} " << cache.invalidations << "\n"
+		<< "# HELP webserv_file_cache_bytes Bytes held by the shared file cache.\n"
+		<< "# TYPE webserv_file_cache_bytes gauge\n"
+		<< "webserv_file_cache_bytes " << cache.bytes << "\n";
+	return out.str();
+}
+
+std::string Metrics::renderJson()
+{
+	Aggregate total = collect();
+	FileCache::Stats cache = FileCache::instance().getStats();
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3);
+
+	out << "{\"uptime_seconds\":" << std::chrono::duration<double>(std::chrono::steady_clock::now() - processStart).count()
+		<< ",\"connections\":{\"accepted\":" << total.accepted << ",\"active\":" << total.active << "}"
+		<< ",\"requests\":[";
+	bool first = true;
+	for (const auto& [key, counters] : total.requests)
+	{
+		out << (first ? "" : ",") << "{\"vhost\":\"" << escapeJson(key.first)
+			<< "\",\"location\":\"" << escapeJson(key.second) << "\"";
+		for (size_t i = 0; i < 6; i++)
+			out << ",\"" << classNames[i] << "\":" << counters[i];
+		out << "}";
+		first = false;
+	}
+
+	out << "],\"phases\":{";
+	for (size_t phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		const Aggregate::Phase& histogram = total.phases[phase];
+		double mean = histogram.count ? static_cast<double>(histogram.sum) / histogram.count : 0;
+		out << (phase ? "," : "") << "\"" << phaseNames[phase] << "\":{\"count\":" << histogram.count
+			<< ",\"mean_us\":" << mean / 1e3
+			<< ",\"p50_us\":" << histogram.quantile(0.5) / 1e3
+			<< ",\"p90_us\":" << histogram.quantile(0.9) / 1e3
+			<< ",\"p99_us\":" << histogram.quantile(0.99) / 1e3
+			<< ",\"p999_us\":" << histogram.quantile(0.999) / 1e3
+			<< ",\"max_us\":" << histogram.max / 1e3 << "}";
+	}
+
+	out << "},\"file_cache\":{\"hits\":" << cache.hits << ",\"misses\":" << cache.misses
+		<< ",\"evictions\":" << cache.evictions << ",\"invalidations\":" << cache.invalidations
+		<< ",\"entries\":" << cache.entries << ",\"bytes\":" << cache.bytes << "}}\n";
+	return out.str();
+}
@@ -0,0 +1,215 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MimeTypes.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/22 11:37:05 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/22 11:37:05 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "MimeTypes.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+	struct DefaultType
+	{
+		std::string_view extension;
+		std::string_view type;
+	};
+
+	constexpr DefaultType defaultTypes[] = {
+		{"html", "text/html"}, {"htm", "text/html"}, {"shtml", "text/html"},
+		{"css", "text/css"}, {"txt", "text/plain"}, {"csv", "text/csv"}, {"md", "text/markdown"},
+		{"xml", "application/xml"}, {"js", "application/javascript"}, {"mjs", "application/javascript"},
+		{"json", "application/json"}, {"map", "application/json"}, {"wasm", "application/wasm"},
+		{"jpg", "image/jpeg"}, {"jpeg", "image/jpeg"}, {"png", "image/png"}, {"gif", "image/gif"},
+		{"webp", "image/webp"}, {"avif", "image/avif"}, {"svg", "image/svg+xml"}, {"ico", "image/x-icon"},
+		{"bmp", "image/bmp"}, {"tif", "image/tiff"}, {"tiff", "image/tiff"},
+		{"woff", "font/woff"}, {"woff2", "font/woff2"}, {"ttf", "font/ttf"}, {"otf", "font/otf"},
+		{"mp3", "audio/mpeg"}, {"ogg", "audio/ogg"}, {"wav", "audio/wav"}, {"m4a", "audio/mp4"},
+		{"mp4", "video/mp4"}, {"webm", "video/webm"}, {"mov", "video/quicktime"},
+		{"pdf", "application/pdf"}, {"zip", "application/zip"}, {"gz", "application/gzip"},
+		{"tar", "application/x-tar"}
+	};
+
+	// Types whose body is text in the configured charset
+	bool takesCharset(const std::string& type)
+	{
+		return type.compare(0, 5, "text/") == 0 || type == "application/javascript"
+			|| type == "application/json" || type == "application/xml" || type == "application/rss+xml";
+	}
+
+	char lower(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	uint32_t roundUpPowerOfTwo(size_t value)
+	{
+		uint32_t power = 1;
+		while (power < value)
+			power <<= 1;
+		return power;
+	}
+
+	// Each bucket tries this many seeds before the table is grown
+	constexpr uint32_t maxSeedAttempts = 1u << 16;
+}
+
+MimeTypes& MimeTypes::instance()
+{
+	static MimeTypes mimeTypes;
+	return mimeTypes;
+}
+
+MimeTypes::MimeTypes()
+{
+	for (const DefaultType& entry : defaultTypes)
+		add(entry.type, entry.extension);
+	compile();
+}
+
+void MimeTypes::add(std::string_view type, std::string_view extension)
+{
+	std::string key(extension);
+	std::transform(key.begin(), key.end(), key.begin(), lower);
+	if (!key.empty() && key[0] == '.')
+		key.erase(0, 1);
+	if (key.empty() || type.empty())
+		throw std::runtime_error("Empty MIME type or extension");
+	_extensions[key] = std::string(type);
+}
+
+void MimeTypes::setCharset(std::string_view charset)
+{
+	_charset = (charset == "off") ? "" : std::string(charset);
+}
+
+// FNV-1a over the lowercased bytes, the seed changes the offset basis and a final mix spreads it
+uint32_t MimeTypes::hash(std::string_view extension, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+	for (char c : extension)
+	{
+		h ^= static_cast<unsigned char>(lower(c));
+		h *= 16777619u;
+	}
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h;
+}
+
+void MimeTypes::compile()
+{
+	_types.clear();
+	_types.push_back({"application/octet-stream", ""});
+	std::map<std::string, uint32_t> typeIndex;
+	for (const auto& [extension, type] : _extensions)
+	{
+		if (typeIndex.emplace(type, static_cast<uint32_t>(_types.size())).second)
+			_types.push_back({type, ""});
+	}
+	for (MimeType& type : _types)
+	{
+		type.headerLine = "Content-Type: " + type.name;
+		if (!_charset.empty() && takesCharset(type.name))
+			type.headerLine += "; charset=" + _charset;
+		type.headerLine += "\r\n";
+	}
+
+	// About four extensions per bucket, and a quarter of the slots left free so every bucket finds a seed quickly
+	size_t count = _extensions.size();
+	_bucketMask = roundUpPowerOfTwo(std::max<size_t>(1, count / 4)) - 1;
+	std::vector<std::vector<std::string>> buckets(_bucketMask + 1);
+	for (const auto& [extension, type] : _extensions)
+		buckets[hash(extension, 0) & _bucketMask].push_back(extension);
+
+	size_t slotCount = roundUpPowerOfTwo(std::max<size_t>(8, count + count / 4));
+	while (!place(buckets, slotCount))
+		slotCount *= 2;
+
+	for (Slot& slot : _slots)
+	{
+		if (!slot.extension.empty())
+			slot.type = typeIndex[_extensions[slot.extension]];
+	}
+}
+
+// Largest buckets first, each takes the first seed that puts all of its extensions into free slots
+bool MimeTypes::place(const std::vector<std::vector<std::string>>& buckets, size_t slotCount)
+{
+	_slots.assign(slotCount, Slot());
+	_slotMask = static_cast<uint32_t>(slotCount - 1);
+	_seeds.assign(buckets.size(), 0);
+
+	std::vector<uint32_t> order(buckets.size());
+	for (uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	std::vector<uint32_t> positions;
+	for (uint32_t bucket : order)
+	{
+		if (buckets[bucket].empty())
+			break;
+		uint32_t seed = 1;
+		for (; seed < maxSeedAttempts; seed++)
+		{
+			positions.clear();
+			for (const std::string& extension : buckets[bucket])
+			{
+				uint32_t position = hash(extension, seed) & _slotMask;
+				if (!_slots[position].extension.empty()
+					|| std::find(positions.begin(), positions.end(), position) != positions.end())
+					break;
+				positions.push_back(position);
+			}
+			if (positions.size() == buckets[bucket].size())
+				break;
+		}
+		if (seed == maxSeedAttempts)
+			return false;
+
+		_seeds[bucket] = seed;
+		for (size_t i = 0; i < positions.size(); i++)
+			_slots[positions[i]].extension = buckets[bucket][i];
+	}
+	return true;
+}
+
+const MimeType& MimeTypes::lookup(std::string_view path) const
+{
+	size_t dot = path.find_last_of("./");
+	if (dot == std::string_view::npos || path[dot] != '.' || dot + 1 == path.size())
+		return _types[0];
+	std::string_view extension = path.substr(dot + 1);
+
+	const Slot& slot = _slots[hash(extension, _seeds[hash(extension, 0) & _bucketMask]) & _slotMask];
+	if (slot.extension.size() != extension.size())
+		return _types[0];
+	for (size_t i = 0; i < extension.size(); i++)
+	{
+		if (lower(extension[i]) != slot.extension[i])
+			return _types[0];
+	}
+	return _types[slot.type];
+}
+
+size_t MimeTypes::getTypeCount() const
+{
+	return _extensions.size();
+}
+
+size_t MimeTypes::getSlotCount() const
+{
+	return _slots.size();
+}
@@ -0,0 +1,358 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MultipartParser.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/24 10:41:52 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/24 10:41:52 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "MultipartParser.hpp"
+#include "Scan.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace
+{
+	// A part's header section larger than this is refused as malformed
+	constexpr size_t maxPartHeaderSize = 8192;
+	// Fresh bytes joined to the carried window per step, enough to finish a delimiter or a few header lines
+	constexpr size_t seamBytes = 4096;
+
+	bool equalsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](char x, char y) { return ::tolower(static_cast<unsigned char>(x)) == ::tolower(static_cast<unsigned char>(y)); });
+	}
+
+	std::string_view trimSpaces(std::string_view value)
+	{
+		size_t first = value.find_first_not_of(" \t");
+		if (first == std::string_view::npos)
+			return {};
+		size_t last = value.find_last_not_of(" \t");
+		return value.substr(first, last - first + 1);
+	}
+
+	// Pops the next "key=value" or "key" parameter off rest, a quoted value may contain ';' and escaped quotes
+	bool nextParameter(std::string_view& rest, std::string_view& key, std::string& value)
+	{
+		rest = rest.substr(std::min(rest.find_first_not_of("; \t"), rest.size()));
+		if (rest.empty())
+			return false;
+		size_t keyEnd = std::min(rest.find_first_of("=;"), rest.size());
+		key = trimSpaces(rest.substr(0, keyEnd));
+		value.clear();
+		rest.remove_prefix(keyEnd);
+		if (rest.empty() || rest[0] == ';')
+			return true;
+
+		rest = trimSpaces(rest.substr(1));
+		if (!rest.empty() && rest[0] == '"')
+		{
+			size_t i = 1;
+			for (; i < rest.size() && rest[i] != '"'; i++)
+			{
+				if (rest[i] == '\\' && i + 1 < rest.size())
+					i++;
+				value += rest[i];
+			}
+			rest.remove_prefix(std::min(i + 1, rest.size()));
+		}
+		else
+		{
+			size_t valueEnd = std::min(rest.find(';'), rest.size());
+			value = std::string(trimSpaces(rest.substr(0, valueEnd)));
+			rest.remove_prefix(valueEnd);
+		}
+		return true;
+	}
+}
+
+// The leading CRLF lets a boundary on the very first line match the same delimiter as every later one
+MultipartParser::MultipartParser(std::string_view boundary, PathFor pathFor)
+	: _state(PREAMBLE), _delimiter("\r\n--" + std::string(boundary)), _window("\r\n"),
+	  _pathFor(std::move(pathFor)), _fd(-1), _errorStatus(0), _finished(false)
+{
+}
+
+MultipartParser::~MultipartParser()
+{
+	if (_fd >= 0)
+		close(_fd);
+	if (!_finished)
+		removeFiles();
+}
+
+bool MultipartParser::boundaryOf(std::string_view contentType, std::string& boundary)
+{
+	std::string_view rest = contentType.substr(std::min(contentType.find(';'), contentType.size()));
+	std::string_view key;
+	std::string value;
+	while (nextParameter(rest, key, value))
+	{
+		if (!equalsIgnoreCase(key, "boundary"))
+			continue;
+		// RFC 2046 5.1.1: 1 to 70 characters, not ending in a space
+		if (value.empty() || value.size() > 70 || value.back() == ' ')
+			return false;
+		boundary = value;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Parses in place whatever can be decided without the next bytes. Only the
+ * undecided tail is copied: at most a delimiter's length inside a part body,
+ * an incomplete header section while headers are read.
+ */
+bool MultipartParser::write(std::string_view data)
+{
+	while (!data.empty() && _state != FAILED)
+	{
+		if (_window.empty())
+		{
+			size_t used = consume(data);
+			if (_state != FAILED)
+				_window.assign(data.substr(used));
+			break;
+		}
+		size_t take = std::min(data.size(), _delimiter.size() + seamBytes);
+		_window.append(data.substr(0, take));
+		data.remove_prefix(take);
+		size_t left = _window.size() - consume(_window);
+		if (_state == FAILED)
+			break;
+		// Undecided bytes that all came from data go back to it, so the bulk is parsed in place again
+		if (left <= take)
+		{
+			data = std::string_view(data.data() - left, data.size() + left);
+			_window.clear();
+		}
+		else
+		{
+			_window.erase(0, _window.size() - left);
+		}
+	}
+	return _errorStatus != 500;
+}
+
+// Returns how many bytes of data were used, the rest has to be offered again with more input
+size_t MultipartParser::consume(std::string_view data)
+{
+	size_t pos = 0;
+	while (true)
+	{
+		std::string_view rest = data.substr(pos);
+		switch (_state)
+		{
+			case PREAMBLE:
+			case PART_BODY:
+			{
+				// Everything before a delimiter, or before the bytes that could still start one, is content
+				size_t found = scan::find(rest, _delimiter);
+				size_t content = (found != std::string_view::npos) ? found
+					: rest.size() - std::min(rest.size(), _delimiter.size() - 1);
+				if (_state == PART_BODY && content > 0 && !emit(rest.substr(0, content)))
+				{
+					fail(500);
+					return data.size();
+				}
+				if (found == std::string_view::npos)
+					return pos + content;
+				if (_state == PART_BODY)
+					endPart();
+				pos += found + _delimiter.size();
+				_state = BOUNDARY_END;
+				break;
+			}
+			case BOUNDARY_END:
+			{
+				// "--" closes the body, otherwise the delimiter line ends after optional padding
+				if (rest.size() < 2)
+					return pos;
+				if (rest.substr(0, 2) == "--")
+				{
+					pos += 2;
+					_state = EPILOGUE;
+					break;
+				}
+				size_t lineEnd = rest.find_first_not_of(" \t");
+				if (lineEnd == std::string_view::npos || rest.size() - lineEnd < 2)
+				{
+					if (rest.size() > seamBytes)
+						fail(400);
+					return (_state == FAILED) ? data.size() : pos;
+				}
+				if (rest.substr(lineEnd, 2) != "\r\n")
+				{
+					fail(400);
+					return data.size();
+				}
+				pos += lineEnd + 2;
+				_state = PART_HEADERS;
+				break;
+			}
+			case PART_HEADERS:
+			{
+				if (rest.size() < 2)
+					return pos;
+				// A part may have no header fields at all, then the blank line follows the delimiter
+				size_t headersEnd = (rest.substr(0, 2) == "\r\n") ? 0 : scan::findHeaderEnd(rest);
+				if (headersEnd == std::string_view::npos)
+				{
+					if (rest.size() > maxPartHeaderSize)
+						fail(400);
+					return (_state == FAILED) ? data.size() : pos;
+				}
+				std::string_view headers = (headersEnd == 0) ? std::string_view() : rest.substr(0, headersEnd + 2);
+				if (!beginPart(headers))
+					return data.size();
+				pos += (headersEnd == 0) ? 2 : headersEnd + 4;
+				_state = PART_BODY;
+				break;
+			}
+			case EPILOGUE:
+			case FAILED:
+				return data.size();
+		}
+	}
+}
+
+bool MultipartParser::beginPart(std::string_view headers)
+{
+	Part part;
+	part.contentType = "text/plain";
+	bool disposition = false;
+	while (!headers.empty())
+	{
+		std::string_view line = scan::nextLine(headers);
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos || colon == 0)
+		{
+			fail(400);
+			return false;
+		}
+		std::string_view name = line.substr(0, colon);
+		std::string_view value = trimSpaces(line.substr(colon + 1));
+		if (equalsIgnoreCase(name, "Content-Disposition"))
+		{
+			std::string_view rest = value;
+			std::string_view key;
+			std::string parameter;
+			if (!nextParameter(rest, key, parameter) || !equalsIgnoreCase(key, "form-data"))
+			{
+				fail(400);
+				return false;
+			}
+			disposition = true;
+			while (nextParameter(rest, key, parameter))
+			{
+				if (equalsIgnoreCase(key, "name"))
+					part.name = parameter;
+				else if (equalsIgnoreCase(key, "filename"))
+					part.filename = parameter;
+			}
+		}
+		else if (equalsIgnoreCase(name, "Content-Type") && !value.empty())
+		{
+			part.contentType = std::string(value);
+		}
+	}
+	// RFC 7578 4.2: every part names its field
+	if (!disposition)
+	{
+		fail(400);
+		return false;
+	}
+
+	// A file input left empty is sent with filename="", there is nothing to store for it
+	part.isFile = !part.filename.empty();
+	if (part.isFile)
+	{
+		part.savedAs = _pathFor(part);
+		if (!part.savedAs.empty())
+			_fd = open(part.savedAs.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (_fd < 0)
+		{
+			part.savedAs.clear();
+			_parts.push_back(std::move(part));
+			fail(500);
+			return false;
+		}
+	}
+	_parts.push_back(std::move(part));
+	return true;
+}
+
+bool MultipartParser::emit(std::string_view data)
+{
+	_parts.back().size += data.size();
+	while (_fd >= 0 && !data.empty())
+	{
+		ssize_t written = ::write(_fd, data.data(), data.size());
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data.remove_prefix(static_cast<size_t>(written));
+	}
+	return true;
+}
+
+void MultipartParser::endPart()
+{
+	if (_fd >= 0)
+		close(_fd);
+	_fd = -1;
+}
+
+bool MultipartParser::finish()
+{
+	if (_state == FAILED)
+		return false;
+	// Without the closing delimiter the last part may be cut short
+	if (_state != EPILOGUE)
+	{
+		fail(400);
+		return false;
+	}
+	_finished = true;
+	return true;
+}
+
+void MultipartParser::fail(int status)
+{
+	_errorStatus = status;
+	_state = FAILED;
+	_window.clear();
+	endPart();
+	removeFiles();
+}
+
+void MultipartParser::removeFiles()
+{
+	for (Part& part : _parts)
+	{
+		if (!part.savedAs.empty())
+			unlink(part.savedAs.c_str());
+		part.savedAs.clear();
+	}
+}
+
+int MultipartParser::getErrorStatus() const
+{
+	return _errorStatus;
+}
+
+const std::vector<MultipartParser::Part>& MultipartParser::getParts() const
+{
+	return _parts;
+}
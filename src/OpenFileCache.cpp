@@ -0,0 +1,205 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OpenFileCache.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/13 10:44:58 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/13 10:44:58 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "OpenFileCache.hpp"
+#include "HTTPResponse.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+
+#ifdef __APPLE__
+# define MTIME(st) ((st).st_mtimespec)
+#else
+# define MTIME(st) ((st).st_mtim)
+#endif
+
+OpenFileCache::OpenFileCache() : _maxEntries(1000), _valid(std::chrono::seconds(5)), _cacheErrors(true) {}
+
+void OpenFileCache::configure(size_t maxEntries, std::chrono::milliseconds valid, bool cacheErrors)
+{
+	_maxEntries = maxEntries;
+	_valid = valid;
+	_cacheErrors = cacheErrors;
+}
+
+std::shared_ptr<const OpenFileCache::FileInfo> OpenFileCache::get(const std::string& path, bool revalidate)
+{
+	return lookup(path, revalidate, true);
+}
+
+std::shared_ptr<const OpenFileCache::FileInfo> OpenFileCache::stat(const std::string& path)
+{
+	return lookup(path, false, false);
+}
+
+std::shared_ptr<const OpenFileCache::FileInfo> OpenFileCache::lookup(const std::string& path, bool revalidate, bool openFile)
+{
+	auto now = std::chrono::steady_clock::now();
+	auto it = _entries.find(path);
+	if (it != _entries.end())
+	{
+		Entry& entry = it->second;
+		_lru.splice(_lru.begin(), _lru, entry.lruPosition);
+		// A regular file known from stat() alone is opened once its contents are wanted
+		if (!openFile || entry.info->file || entry.info->error || entry.info->isDirectory)
+		{
+			if (!revalidate && now - entry.validated < _valid)
+				return entry.info;
+
+			// One stat decides whether the open fd still describes the file behind the path
+			struct stat st;
+			int result = ::stat(path.c_str(), &st);
+			if ((result == 0 && entry.info->error == 0 && unchanged(*entry.info, st))
+				|| (result < 0 && entry.info->error == errno))
+			{
+				entry.validated = now;
+				return entry.info;
+			}
+		}
+		_lru.erase(entry.lruPosition);
+		_entries.erase(it);
+	}
+
+	std::shared_ptr<const FileInfo> info = openFile ? load(path) : loadMetadata(path);
+	// Out of fds says nothing about the path: give back the oldest cached ones and try once more
+	if (outOfFiles(info->error) && releaseFiles(std::max<size_t>(1, _entries.size() / 4)) > 0)
+		info = load(path);
+	if (_maxEntries == 0 || (info->error && !(_cacheErrors && describesPath(info->error))))
+		return info;
+
+	while (_entries.size() >= _maxEntries)
+	{
+		_entries.erase(_lru.back());
+		_lru.pop_back();
+	}
+	_lru.push_front(path);
+	_entries[path] = Entry{info, now, _lru.begin()};
+	return info;
+}
+
+// Closes the cached fds of up to count least recently used files, a transfer still in flight keeps its own
+size_t OpenFileCache::releaseFiles(size_t count)
+{
+	size_t released = 0;
+	for (auto it = _lru.end(); it != _lru.begin() && released < count; )
+	{
+		--it;
+		auto entry = _entries.find(*it);
+		if (!entry->second.info->file)
+			continue;
+		_entries.erase(entry);
+		it = _lru.erase(it);
+		released++;
+	}
+	return released;
+}
+
+bool OpenFileCache::outOfFiles(int error)
+{
+	return error == EMFILE || error == ENFILE;
+}
+
+// Only these are answers about the path itself, anything else may be gone on the next try
+bool OpenFileCache::describesPath(int error)
+{
+	return error == ENOENT || error == ENOTDIR || error == EACCES;
+}
+
+void OpenFileCache::invalidate(const std::string& path)
+{
+	auto it = _entries.find(path);
+	if (it == _entries.end())
+		return;
+	_lru.erase(it->second.lruPosition);
+	_entries.erase(it);
+}
+
+/**
+ * open + fstat instead of stat + open: one syscall less and the metadata is
+ * guaranteed to describe the fd that will be sent. O_NONBLOCK keeps a FIFO under
+ * the root from stalling the loop, regular files ignore it.
+ */
+std::shared_ptr<const OpenFileCache::FileInfo> OpenFileCache::load(const std::string& path)
+{
+	auto info = std::make_shared<FileInfo>();
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+	if (fd < 0)
+	{
+		info->error = errno;
+		return info;
+	}
+	auto file = std::make_shared<FileHandle>(fd);
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		info->error = errno;
+		return info;
+	}
+	describe(*info, st, path);
+	if (info->isDirectory || info->error)
+		return info;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	info->file = std::move(file);
+	return info;
+}
+
+std::shared_ptr<const OpenFileCache::FileInfo> OpenFileCache::loadMetadata(const std::string& path)
+{
+	auto info = std::make_shared<FileInfo>();
+	struct stat st;
+	if (::stat(path.c_str(), &st) < 0)
+		info->error = errno;
+	else
+		describe(*info, st, path);
+	return info;
+}
+
+// The inode, size and nanosecond mtime together change with every replacement or write of the file
+void OpenFileCache::describe(FileInfo& info, const struct stat& st, const std::string& path)
+{
+	info.size = static_cast<uint64_t>(st.st_size);
+	info.mtime = MTIME(st);
+	info.device = st.st_dev;
+	info.inode = st.st_ino;
+
+	if (S_ISDIR(st.st_mode))
+	{
+		info.isDirectory = true;
+		return;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		info.error = EACCES;
+		return;
+	}
+	info.contentType = &MimeTypes::instance().lookup(path);
+
+	std::ostringstream etag;
+	etag << '"' << std::hex << static_cast<uint64_t>(st.st_ino) << '-' << info.size << '-'
+		<< static_cast<uint64_t>(info.mtime.tv_sec) * 1000000000ull + static_cast<uint64_t>(info.mtime.tv_nsec) << '"';
+	info.etag = etag.str();
+	info.lastModified = HTTPResponse::httpDate(info.mtime.tv_sec);
+}
+
+bool OpenFileCache::unchanged(const FileInfo& info, const struct stat& st)
+{
+	return info.inode == st.st_ino && info.device == st.st_dev
+		&& info.size == static_cast<uint64_t>(st.st_size)
+		&& info.mtime.tv_sec == MTIME(st).tv_sec && info.mtime.tv_nsec == MTIME(st).tv_nsec
+		&& info.isDirectory == S_ISDIR(st.st_mode);
+}
@@ -11,10 +11,11 @@
 /* ************************************************************************** */
 
 #include "ParseConfig.hpp"
+#include "Logger.hpp"
 #include <map>
 #include <sstream>
-#include <iostream>
 #include <algorithm>
+#include <thread>
 
 // ------------------------------------------------------------------------
 // Constructor and Parsing Methods
@@ -32,11 +33,11 @@ void parseConfig::parse(const std::string& filename)
 
 	if (brackets != 0)
 	{
-		std::cerr << YELLOW("[INFO] Mismatched brackets in configuration file.") << std::endl;
+		LOG_ERROR("Mismatched brackets in configuration file.");
 		throw SyntaxErrorException();
 	}
 
-	std::cout << GREEN("[INFO] Configuration file parsed successfully.") << std::endl;
+	LOG_INFO("Configuration file parsed successfully.");
 }
 
 // ------------------------------------------------------------------------
@@ -94,6 +95,22 @@ void parseConfig::splitMaps(std::string& line, int& brackets)
 		brackets--;
 	}
 
+	// types { } maps MIME types to extensions, its lines never reach the server or location maps
+	if (_inTypes)
+	{
+		if (line.find('}') != std::string::npos)
+			_inTypes = false;
+		else
+			parseTypes(line);
+		return;
+	}
+	std::string trimmedLine = trim(line);
+	if (trimmedLine.compare(0, 5, "types") == 0 && trimmedLine.find('{') == trimmedLine.find_first_not_of(" \t", 5))
+	{
+		_inTypes = true;
+		return;
+	}
+
 	if (line.find("server ") != std::string::npos || line.find("server\t") != std::string::npos)
 	{
 		_blocks.push("server");
@@ -144,6 +161,10 @@ void parseConfig::trimServer(const std::string& line)
 		{
 			_index = value;
 		}
+		else if (key == "include")
+		{
+			includeTypes(value);
+		}
 		else if (key == "error_pages")
 		{
 			std::istringstream errorStream(value);
@@ -198,8 +219,73 @@ void parseConfig::fillLocationMap(std::string& line, const std::string& location
 		{
 			_cgiConfig[location].cgiPass = value;
 		}
+		else if (key == "client_max_body_size")
+		{
+			_locationBodySizes[location] = parseSize(value);
+		}
 	}
 }
+// ------------------------------------------------------------------------
+// MIME Types Parsing
+// ------------------------------------------------------------------------
+
+// Statements of the form "type ext ext ...;" as in nginx's mime.types, # starts a comment
+void parseConfig::parseTypes(const std::string& text)
+{
+	std::istringstream lines(text);
+	std::string line;
+	std::string statements;
+	while (std::getline(lines, line))
+	{
+		statements += line.substr(0, line.find('#'));
+		statements += ' ';
+	}
+
+	std::istringstream statementStream(statements);
+	std::string statement;
+	while (std::getline(statementStream, statement, ';'))
+	{
+		std::istringstream words(statement);
+		std::string type, extension;
+		if (!(words >> type))
+			continue;
+		if (type.find('/') == std::string::npos)
+			throw SyntaxErrorException();
+		while (words >> extension)
+			_mimeTypes.push_back({type, extension});
+	}
+}
+
+// include only takes mime.types files, their content is one types { } block
+void parseConfig::includeTypes(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open included file: " << path);
+		throw SyntaxErrorException();
+	}
+	std::stringstream content;
+	content << file.rdbuf();
+	std::string text = content.str();
+
+	size_t open = text.find('{');
+	size_t close = text.rfind('}');
+	std::string head = text.substr(0, open == std::string::npos ? 0 : open);
+	if (open == std::string::npos || close == std::string::npos || close < open
+		|| trim(head.substr(head.rfind('\n') + 1)) != "types")
+	{
+		LOG_ERROR("Included file is not a types { } block: " << path);
+		throw SyntaxErrorException();
+	}
+	parseTypes(text.substr(open + 1, close - open - 1));
+}
+
+const std::vector<std::pair<std::string, std::string>>& parseConfig::getMimeTypes() const
+{
+	return _mimeTypes;
+}
+
 // ------------------------------------------------------------------------
 // CGI Configuration Parsing
 // ------------------------------------------------------------------------
@@ -215,22 +301,32 @@ const parseConfig::CGIConfig& parseConfig::getCGIConfig(const std::string& locat
 // ------------------------------------------------------------------------
 void parseConfig::parseClientMaxBodySize(const std::string& value)
 {
-	std::string trimmedValue = trim(value);
-	if (trimmedValue.empty())
+	_clientMaxBodySize[_currentServerBlock] = parseSize(value);
+}
+
+// Parses sizes such as 512, 16k, 10M or 1gb into bytes
+size_t parseConfig::parseSize(const std::string& value)
+{
+	size_t first = value.find_first_not_of(" \t");
+	if (first == std::string::npos)
 		throw SyntaxErrorException();
+	std::string trimmedValue = value.substr(first, value.find_last_not_of(" \t;") - first + 1);
 
 	size_t numericPart = 0;
 	std::string unit;
 
 	size_t unitPos = trimmedValue.find_first_not_of("0123456789");
+	if (unitPos == 0)
+		throw SyntaxErrorException();
 	if (unitPos == std::string::npos)
 	{
-		numericPart = std::stoi(trimmedValue);
+		numericPart = std::stoul(trimmedValue);
 	}
 	else
 	{
-		numericPart = std::stoi(trimmedValue.substr(0, unitPos));
-		unit = trim(trimmedValue.substr(unitPos));
+		numericPart = std::stoul(trimmedValue.substr(0, unitPos));
+		unit = trimmedValue.substr(unitPos);
+		unit.erase(0, unit.find_first_not_of(" \t"));
 		std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
 	}
 
@@ -244,12 +340,78 @@ void parseConfig::parseClientMaxBodySize(const std::string& value)
 	else if (!unit.empty() && unit != "b")
 		throw SyntaxErrorException();
 
-	_clientMaxBodySize[_currentServerBlock] = size;
+	return size;
 }
 
 // ------------------------------------------------------------------------
 // Getters for Configuration Data
 // ------------------------------------------------------------------------
+
+/**
+ * Number of event loops started for this server block, from
+ * worker_threads (or its alias worker_processes). "auto" uses one per core.
+ */
+int parseConfig::getWorkerCount() const
+{
+	auto it = _parsingServer.find("worker_threads");
+	if (it == _parsingServer.end())
+		it = _parsingServer.find("worker_processes");
+	if (it == _parsingServer.end())
+		return 1;
+
+	if (it->second == "auto")
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 0 ? static_cast<int>(cores) : 1;
+	}
+
+	int count = 0;
+	try {
+		count = std::stoi(it->second);
+	}
+	catch (const std::exception&)
+	{
+		throw SyntaxErrorException();
+	}
+	if (count < 1)
+		throw SyntaxErrorException();
+	return count;
+}
+
+/**
+ * Every directive of every location block, keyed by location, for the
+ * LocationRouter to compile. Blocks repeating a location are already merged.
+ */
+std::map<std::string, LocationDirectives> parseConfig::getLocationDirectives() const
+{
+	std::map<std::string, LocationDirectives> locations;
+	for (const auto& [location, methods] : _allowedMethods)
+	{
+		unsigned mask = 0;
+		for (const std::string& method : methods)
+			mask |= LocationConfig::methodBit(method);
+		locations[location].methods = mask;
+	}
+	for (const auto& [location, root] : _rootDirectories)
+		locations[location].root = root;
+	for (const auto& [location, autoindex] : _autoindexConfig)
+		locations[location].autoindex = autoindex;
+	for (const auto& [location, redirection] : _redirections)
+		locations[location].redirect = redirection;
+	for (const auto& [location, config] : _cgiConfig)
+	{
+		CGIHandler::CGIConfig& cgi = locations[location].cgi.emplace();
+		cgi.cgiPass = config.cgiPass;
+		cgi.scriptFilename = config.scriptFilename;
+		cgi.pathInfo = config.pathInfo;
+		cgi.queryString = config.queryString;
+		cgi.requestMethod = config.requestMethod;
+	}
+	for (const auto& [location, size] : _locationBodySizes)
+		locations[location].clientMaxBodySize = size;
+	return locations;
+}
+
 const std::map<std::string, std::string>& parseConfig::getRedirections() const
 {
 	return _redirections;
@@ -0,0 +1,119 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestBody.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/23 16:02:19 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/23 16:02:19 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RequestBody.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+RequestBody::RequestBody(size_t bufferSize, std::string tempPath)
+	: _bufferSize(bufferSize), _tempPath(std::move(tempPath))
+{
+}
+
+RequestBody::~RequestBody()
+{
+	if (_map)
+		munmap(_map, _size);
+	if (_fd >= 0)
+		close(_fd);
+}
+
+bool RequestBody::write(std::string_view data)
+{
+	if (_fd < 0 && _size + data.size() > _bufferSize && !spool())
+		return false;
+	_size += data.size();
+	if (_fd < 0)
+	{
+		_data.append(data);
+		return true;
+	}
+	while (!data.empty())
+	{
+		ssize_t written = ::write(_fd, data.data(), data.size());
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+		{
+			LOG_ERROR("Cannot write request body to " << _tempPath << ": " << strerror(errno));
+			return false;
+		}
+		data.remove_prefix(static_cast<size_t>(written));
+	}
+	return true;
+}
+
+/**
+ * O_TMPFILE creates the file without a name, so nothing is left behind even if
+ * the process dies. Filesystems without it get a named file that is unlinked
+ * right away. What was buffered so far moves into the file.
+ */
+bool RequestBody::spool()
+{
+#ifdef O_TMPFILE
+	_fd = open(_tempPath.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+	if (_fd < 0)
+	{
+		std::string path = _tempPath + "/webserv-body-XXXXXX";
+		_fd = mkstemp(path.data());
+		if (_fd < 0)
+		{
+			LOG_ERROR("Cannot create request body file in " << _tempPath << ": " << strerror(errno));
+			return false;
+		}
+		unlink(path.c_str());
+		fcntl(_fd, F_SETFD, FD_CLOEXEC);
+	}
+
+	std::string buffered;
+	buffered.swap(_data);
+	_size = 0;
+	return write(buffered);
+}
+
+uint64_t RequestBody::size() const
+{
+	return _size;
+}
+
+bool RequestBody::inFile() const
+{
+	return _fd >= 0;
+}
+
+std::string_view RequestBody::data() const
+{
+	if (_fd < 0 || _size == 0)
+		return _data;
+	if (!_map)
+	{
+		void* map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+		if (map == MAP_FAILED)
+		{
+			LOG_ERROR("Cannot map request body: " << strerror(errno));
+			return {};
+		}
+		_map = map;
+	}
+	return std::string_view(static_cast<const char*>(_map), _size);
+}
+
+int RequestBody::getFd() const
+{
+	return _fd;
+}
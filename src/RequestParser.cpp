@@ -0,0 +1,438 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestParser.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/06 14:23:02 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/06 14:23:02 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RequestParser.hpp"
+#include "Scan.hpp"
+#include <algorithm>
+#include <cctype>
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+		[](char x, char y) { return ::tolower(static_cast<unsigned char>(x)) == ::tolower(static_cast<unsigned char>(y)); });
+}
+
+static std::string_view trimSpaces(std::string_view value)
+{
+	size_t first = value.find_first_not_of(" \t");
+	if (first == std::string_view::npos)
+		return {};
+	size_t last = value.find_last_not_of(" \t");
+	return value.substr(first, last - first + 1);
+}
+
+// Framing, routing and content metadata must not be changed by a trailer (RFC 9110 6.5.1)
+static bool forbiddenTrailer(std::string_view name)
+{
+	static const std::string_view forbidden[] = {
+		"Content-Length", "Transfer-Encoding", "Trailer", "Host", "Connection", "Expect",
+		"Content-Type", "Content-Encoding", "Content-Range", "Range", "Authorization", "Cookie"
+	};
+	for (std::string_view field : forbidden)
+	{
+		if (equalsIgnoreCase(name, field))
+			return true;
+	}
+	return false;
+}
+
+RequestParser::RequestParser() : _maxHeaderSize(16384)
+{
+	reset();
+}
+
+void RequestParser::setMaxHeaderSize(size_t maxHeaderSize)
+{
+	_maxHeaderSize = maxHeaderSize;
+}
+
+void RequestParser::reset()
+{
+	_state = REQUEST_LINE;
+	_chunkState = CHUNK_SIZE;
+	_bodyLimit = 0;
+	_bodyLimitSet = false;
+	_requestStart = 0;
+	_fieldsStart = 0;
+	_scanOffset = 0;
+	_headerLength = 0;
+	_contentLength = 0;
+	_chunkRemaining = 0;
+	_chunked = false;
+	_expectContinue = false;
+	_errorStatus = 0;
+	_host.clear();
+	_bodySink = nullptr;
+	_decodedSize = 0;
+	_released = 0;
+	_trailers.clear();
+}
+
+RequestParser::State RequestParser::fail(int status)
+{
+	_errorStatus = status;
+	_state = FAILED;
+	return _state;
+}
+
+/**
+ * Advances through as many states as the pending bytes allow.
+ * Returns REQUEST_LINE, HEADERS or a BODY state while more input is needed.
+ */
+RequestParser::State RequestParser::parse(std::string_view pending)
+{
+	while (true)
+	{
+		State previous = _state;
+		switch (_state)
+		{
+			case REQUEST_LINE:
+				parseRequestLine(pending);
+				break;
+			case HEADERS:
+				parseHeaders(pending);
+				break;
+			case BODY_LENGTH:
+				if (_bodyLimitSet)
+					parseLength(pending);
+				break;
+			case BODY_CHUNKED:
+				if (_bodyLimitSet)
+					parseChunked(pending);
+				break;
+			case DONE:
+			case FAILED:
+				return _state;
+		}
+		if (_state == previous || awaitingBodyLimit())
+			return _state;
+	}
+}
+
+RequestParser::State RequestParser::parseRequestLine(std::string_view pending)
+{
+	// Stray CRLFs between pipelined requests are ignored, as RFC 9112 allows
+	while (_requestStart + 1 < pending.size() && pending[_requestStart] == '\r' && pending[_requestStart + 1] == '\n')
+		_requestStart += 2;
+	_scanOffset = std::max(_scanOffset, _requestStart);
+
+	size_t lineEnd = scan::findLineEnd(pending, _scanOffset);
+	if (lineEnd == std::string_view::npos)
+	{
+		if (pending.size() - _requestStart > _maxHeaderSize)
+			return fail(414);
+		// The last byte may be the '\r' of the terminator
+		_scanOffset = std::max(_requestStart, pending.empty() ? 0 : pending.size() - 1);
+		return _state;
+	}
+
+	std::string_view line = pending.substr(_requestStart, lineEnd - _requestStart);
+	size_t methodEnd = line.find(' ');
+	size_t targetEnd = (methodEnd == std::string_view::npos) ? methodEnd : line.find(' ', methodEnd + 1);
+	if (methodEnd == 0 || targetEnd == std::string_view::npos || targetEnd == methodEnd + 1)
+		return fail(400);
+
+	std::string_view method = line.substr(0, methodEnd);
+	if (!std::all_of(method.begin(), method.end(), [](char c) { return std::isupper(static_cast<unsigned char>(c)); }))
+		return fail(400);
+
+	std::string_view version = line.substr(targetEnd + 1);
+	if (version != "HTTP/1.1" && version != "HTTP/1.0")
+		return fail(version.substr(0, 5) == "HTTP/" ? 505 : 400);
+
+	_fieldsStart = lineEnd + 2;
+	_scanOffset = lineEnd; // lets "\r\n\r\n" match right away when there are no header fields
+	_state = HEADERS;
+	return _state;
+}
+
+RequestParser::State RequestParser::parseHeaders(std::string_view pending)
+{
+	size_t end = scan::findHeaderEnd(pending, _scanOffset);
+	if (end == std::string_view::npos)
+	{
+		if (pending.size() - _requestStart > _maxHeaderSize)
+			return fail(431);
+		// Resume three bytes back so a terminator split across reads is still found
+		_scanOffset = std::max(_scanOffset, pending.size() >= 3 ? pending.size() - 3 : 0);
+		return _state;
+	}
+
+	_headerLength = end + 4;
+	if (_headerLength - _requestStart > _maxHeaderSize)
+		return fail(431);
+
+	std::string_view fields;
+	if (end > _fieldsStart)
+		fields = pending.substr(_fieldsStart, end - _fieldsStart);
+	if (parseHeaderFields(fields) == FAILED)
+		return _state;
+
+	_scanOffset = _headerLength;
+	if (_chunked)
+		_state = BODY_CHUNKED;
+	else if (_contentLength > 0)
+		_state = BODY_LENGTH;
+	else
+		_state = DONE;
+	return _state;
+}
+
+// Only the fields that decide framing and limits are looked at here
+RequestParser::State RequestParser::parseHeaderFields(std::string_view fields)
+{
+	bool hasContentLength = false;
+	size_t lineStart = 0;
+	while (lineStart < fields.size())
+	{
+		size_t lineEnd = scan::findLineEnd(fields, lineStart);
+		if (lineEnd == std::string_view::npos)
+			lineEnd = fields.size();
+		std::string_view line = fields.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 2;
+
+		size_t colon = line.find(':');
+		if (line.empty() || line[0] == ' ' || line[0] == '\t' || colon == std::string_view::npos || colon == 0
+			|| line[colon - 1] == ' ' || line[colon - 1] == '\t')
+			return fail(400);
+
+		std::string_view name = line.substr(0, colon);
+		std::string_view value = trimSpaces(line.substr(colon + 1));
+
+		if (equalsIgnoreCase(name, "Content-Length"))
+		{
+			if (value.empty() || value.size() > 18
+				|| !std::all_of(value.begin(), value.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+				return fail(400);
+			size_t length = std::stoull(std::string(value));
+			if (hasContentLength && length != _contentLength)
+				return fail(400);
+			hasContentLength = true;
+			_contentLength = length;
+		}
+		else if (equalsIgnoreCase(name, "Transfer-Encoding"))
+		{
+			size_t comma = value.rfind(',');
+			std::string_view lastCoding = trimSpaces(comma == std::string_view::npos ? value : value.substr(comma + 1));
+			if (!equalsIgnoreCase(lastCoding, "chunked"))
+				return fail(400);
+			_chunked = true;
+		}
+		else if (equalsIgnoreCase(name, "Expect"))
+		{
+			_expectContinue = equalsIgnoreCase(value, "100-continue");
+		}
+		else if (equalsIgnoreCase(name, "Host"))
+		{
+			_host = std::string(value);
+		}
+	}
+
+	// Both framings at once is a request smuggling vector, refuse it
+	if (_chunked && hasContentLength)
+		return fail(400);
+	return _state;
+}
+
+void RequestParser::setBodyLimit(size_t maxBodySize)
+{
+	_bodyLimit = maxBodySize;
+	_bodyLimitSet = true;
+	if (_state == BODY_LENGTH && _contentLength > _bodyLimit)
+		fail(413);
+}
+
+// Without a sink the body stays in the caller's buffer, with one it is handed over as it arrives
+RequestParser::State RequestParser::parseLength(std::string_view pending)
+{
+	if (!_bodySink)
+	{
+		if (pending.size() - _headerLength >= _contentLength)
+			_state = DONE;
+		return _state;
+	}
+	size_t available = std::min(pending.size() - _scanOffset, _contentLength - _decodedSize);
+	if (available > 0 && !_bodySink->write(pending.substr(_scanOffset, available)))
+		return fail(500);
+	_scanOffset += available;
+	_decodedSize += available;
+	if (_decodedSize == _contentLength)
+		_state = DONE;
+	return _state;
+}
+
+RequestParser::State RequestParser::parseChunked(std::string_view pending)
+{
+	while (true)
+	{
+		switch (_chunkState)
+		{
+			case CHUNK_SIZE:
+			{
+				size_t lineEnd = scan::findLineEnd(pending, _scanOffset);
+				if (lineEnd == std::string_view::npos)
+				{
+					if (pending.size() - _scanOffset > 1024)
+						return fail(400);
+					return _state;
+				}
+				std::string_view line = pending.substr(_scanOffset, lineEnd - _scanOffset);
+				line = trimSpaces(line.substr(0, line.find(';')));
+				if (line.empty() || line.size() > 15
+					|| !std::all_of(line.begin(), line.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); }))
+					return fail(400);
+
+				_chunkRemaining = std::stoull(std::string(line), nullptr, 16);
+				_scanOffset = lineEnd + 2;
+				if (_chunkRemaining == 0)
+				{
+					_chunkState = CHUNK_TRAILERS;
+				}
+				else
+				{
+					// The limit applies to the decoded payload, chunk framing does not count
+					if (_decodedSize + _chunkRemaining > _bodyLimit)
+						return fail(413);
+					_decodedSize += _chunkRemaining;
+					_chunkState = CHUNK_DATA;
+				}
+				break;
+			}
+			case CHUNK_DATA:
+			{
+				size_t available = std::min(pending.size() - _scanOffset, _chunkRemaining);
+				if (available == 0)
+					return _state;
+				if (_bodySink && !_bodySink->write(pending.substr(_scanOffset, available)))
+					return fail(500);
+				_scanOffset += available;
+				_chunkRemaining -= available;
+				if (_chunkRemaining > 0)
+					return _state;
+				_chunkState = CHUNK_DATA_END;
+				break;
+			}
+			case CHUNK_DATA_END:
+				if (pending.size() - _scanOffset < 2)
+					return _state;
+				if (pending.substr(_scanOffset, 2) != "\r\n")
+					return fail(400);
+				_scanOffset += 2;
+				_chunkState = CHUNK_SIZE;
+				break;
+			case CHUNK_TRAILERS:
+			{
+				size_t lineEnd = scan::findLineEnd(pending, _scanOffset);
+				if (lineEnd == std::string_view::npos)
+				{
+					if (pending.size() - _scanOffset > _maxHeaderSize)
+						return fail(431);
+					return _state;
+				}
+				// A blank line ends the trailer section
+				std::string_view line = pending.substr(_scanOffset, lineEnd - _scanOffset);
+				_scanOffset = lineEnd + 2;
+				if (line.empty())
+				{
+					_state = DONE;
+					return _state;
+				}
+
+				size_t colon = line.find(':');
+				if (line[0] == ' ' || line[0] == '\t' || colon == std::string_view::npos || colon == 0
+					|| line[colon - 1] == ' ' || line[colon - 1] == '\t')
+					return fail(400);
+				if (_trailers.size() + line.size() + 2 > _maxHeaderSize)
+					return fail(431);
+				if (!forbiddenTrailer(line.substr(0, colon)))
+					_trailers.append(line).append("\r\n");
+				break;
+			}
+		}
+	}
+}
+
+bool RequestParser::awaitingBodyLimit() const
+{
+	return !_bodyLimitSet && (_state == BODY_LENGTH || _state == BODY_CHUNKED);
+}
+
+RequestParser::State RequestParser::getState() const
+{
+	return _state;
+}
+
+int RequestParser::getErrorStatus() const
+{
+	return _errorStatus;
+}
+
+size_t RequestParser::getRequestStart() const
+{
+	return _requestStart;
+}
+
+size_t RequestParser::getHeaderLength() const
+{
+	return _headerLength;
+}
+
+size_t RequestParser::getRequestLength() const
+{
+	return (_chunked || _bodySink) ? _scanOffset : _headerLength + _contentLength;
+}
+
+bool RequestParser::isChunked() const
+{
+	return _chunked;
+}
+
+bool RequestParser::expectsContinue() const
+{
+	return _expectContinue;
+}
+
+const std::string& RequestParser::getHost() const
+{
+	return _host;
+}
+
+void RequestParser::setBodySink(BodySink* sink)
+{
+	_bodySink = sink;
+}
+
+// Everything between the header section and the scan offset has been handed to the sink
+size_t RequestParser::releaseBody()
+{
+	if (!_bodySink || (_state != BODY_LENGTH && _state != BODY_CHUNKED && _state != DONE) || _scanOffset <= _headerLength)
+		return 0;
+	size_t released = _scanOffset - _headerLength;
+	_scanOffset = _headerLength;
+	_released += released;
+	return released;
+}
+
+size_t RequestParser::getReleasedBytes() const
+{
+	return _released;
+}
+
+uint64_t RequestParser::getDecodedSize() const
+{
+	return _decodedSize;
+}
+
+const std::string& RequestParser::getTrailers() const
+{
+	return _trailers;
+}
@@ -0,0 +1,295 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Scan.cpp                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/20 10:05:33 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/20 10:05:33 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Scan.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define SCAN_X86 1
+# include <immintrin.h>
+#endif
+
+namespace
+{
+	constexpr size_t npos = std::string_view::npos;
+
+	struct Kernels
+	{
+		size_t (*headerEnd)(const char* data, size_t size, size_t from);
+		size_t (*lineEnd)(const char* data, size_t size, size_t from);
+		size_t (*find)(const char* haystack, size_t size, const char* needle, size_t length, size_t from);
+	};
+
+	size_t headerEndScalar(const char* data, size_t size, size_t from)
+	{
+		for (size_t i = from; i + 4 <= size; i++)
+		{
+			if (data[i] == '\r' && data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n')
+				return i;
+		}
+		return npos;
+	}
+
+	size_t lineEndScalar(const char* data, size_t size, size_t from)
+	{
+		for (size_t i = from; i + 2 <= size; i++)
+		{
+			if (data[i] == '\r' && data[i + 1] == '\n')
+				return i;
+		}
+		return npos;
+	}
+
+	size_t findScalar(const char* haystack, size_t size, const char* needle, size_t length, size_t from)
+	{
+		if (length == 0)
+			return from <= size ? from : npos;
+		for (size_t i = from; i + length <= size; i++)
+		{
+			const void* candidate = std::memchr(haystack + i, needle[0], size - length + 1 - i);
+			if (!candidate)
+				return npos;
+			i = static_cast<const char*>(candidate) - haystack;
+			if (std::memcmp(haystack + i + 1, needle + 1, length - 1) == 0)
+				return i;
+		}
+		return npos;
+	}
+
+#ifdef SCAN_X86
+	// The match masks compare shifted loads, so every set bit is a complete delimiter
+	__attribute__((target("sse2")))
+	size_t headerEndSse2(const char* data, size_t size, size_t from)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		size_t i = from;
+		for (; i + 16 + 3 <= size; i += 16)
+		{
+			const char* p = data + i;
+			__m128i match = _mm_and_si128(
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), cr),
+					_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), lf)),
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2)), cr),
+					_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3)), lf)));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+		return headerEndScalar(data, size, i);
+	}
+
+	__attribute__((target("sse2")))
+	size_t lineEndSse2(const char* data, size_t size, size_t from)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		size_t i = from;
+		for (; i + 16 + 1 <= size; i += 16)
+		{
+			const char* p = data + i;
+			__m128i match = _mm_and_si128(
+				_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), cr),
+				_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), lf));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+		return lineEndScalar(data, size, i);
+	}
+
+	// Candidates must match the first and the last byte of the needle, only those are compared in full
+	__attribute__((target("sse2")))
+	size_t findSse2(const char* haystack, size_t size, const char* needle, size_t length, size_t from)
+	{
+		if (length < 2)
+			return findScalar(haystack, size, needle, length, from);
+		const __m128i first = _mm_set1_epi8(needle[0]);
+		const __m128i last = _mm_set1_epi8(needle[length - 1]);
+		size_t i = from;
+		for (; i + length - 1 + 16 <= size; i += 16)
+		{
+			__m128i match = _mm_and_si128(
+				_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i)), first),
+				_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + length - 1)), last));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+			while (mask)
+			{
+				size_t candidate = i + __builtin_ctz(mask);
+				if (std::memcmp(haystack + candidate + 1, needle + 1, length - 2) == 0)
+					return candidate;
+				mask &= mask - 1;
+			}
+		}
+		return findScalar(haystack, size, needle, length, i);
+	}
+
+	__attribute__((target("avx2")))
+	size_t headerEndAvx2(const char* data, size_t size, size_t from)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		size_t i = from;
+		for (; i + 32 + 3 <= size; i += 32)
+		{
+			const char* p = data + i;
+			__m256i match = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), cr),
+					_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), lf)),
+				_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2)), cr),
+					_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 3)), lf)));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+		return headerEndSse2(data, size, i);
+	}
+
+	__attribute__((target("avx2")))
+	size_t lineEndAvx2(const char* data, size_t size, size_t from)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		size_t i = from;
+		for (; i + 32 + 1 <= size; i += 32)
+		{
+			const char* p = data + i;
+			__m256i match = _mm256_and_si256(
+				_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), cr),
+				_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), lf));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+		return lineEndSse2(data, size, i);
+	}
+
+	__attribute__((target("avx2")))
+	size_t findAvx2(const char* haystack, size_t size, const char* needle, size_t length, size_t from)
+	{
+		if (length < 2)
+			return findScalar(haystack, size, needle, length, from);
+		const __m256i first = _mm256_set1_epi8(needle[0]);
+		const __m256i last = _mm256_set1_epi8(needle[length - 1]);
+		size_t i = from;
+		for (; i + length - 1 + 32 <= size; i += 32)
+		{
+			__m256i match = _mm256_and_si256(
+				_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i)), first),
+				_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + length - 1)), last));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+			while (mask)
+			{
+				size_t candidate = i + __builtin_ctz(mask);
+				if (std::memcmp(haystack + candidate + 1, needle + 1, length - 2) == 0)
+					return candidate;
+				mask &= mask - 1;
+			}
+		}
+		return findSse2(haystack, size, needle, length, i);
+	}
+#endif
+
+	const Kernels scalarKernels = {headerEndScalar, lineEndScalar, findScalar};
+#ifdef SCAN_X86
+	const Kernels sse2Kernels = {headerEndSse2, lineEndSse2, findSse2};
+	const Kernels avx2Kernels = {headerEndAvx2, lineEndAvx2, findAvx2};
+#endif
+
+	const Kernels& kernelsFor(scan::Level level)
+	{
+#ifdef SCAN_X86
+		if (level == scan::AVX2)
+			return avx2Kernels;
+		if (level == scan::SSE2)
+			return sse2Kernels;
+#endif
+		(void)level;
+		return scalarKernels;
+	}
+
+	struct Active
+	{
+		scan::Level level;
+		const Kernels* kernels;
+	};
+
+	// Function-local so a scan during static initialisation still finds its kernels
+	Active& active()
+	{
+		static Active current = {scan::bestLevel(), &kernelsFor(scan::bestLevel())};
+		return current;
+	}
+}
+
+namespace scan
+{
+	size_t findHeaderEnd(std::string_view data, size_t from)
+	{
+		return from < data.size() ? active().kernels->headerEnd(data.data(), data.size(), from) : npos;
+	}
+
+	size_t findLineEnd(std::string_view data, size_t from)
+	{
+		return from < data.size() ? active().kernels->lineEnd(data.data(), data.size(), from) : npos;
+	}
+
+	size_t find(std::string_view haystack, std::string_view needle, size_t from)
+	{
+		if (from > haystack.size())
+			return npos;
+		return active().kernels->find(haystack.data(), haystack.size(), needle.data(), needle.size(), from);
+	}
+
+	std::string_view nextLine(std::string_view& rest)
+	{
+		size_t lineEnd = findLineEnd(rest);
+		std::string_view line = rest.substr(0, lineEnd);
+		rest.remove_prefix(lineEnd == npos ? rest.size() : lineEnd + 2);
+		return line;
+	}
+
+	Level bestLevel()
+	{
+#ifdef SCAN_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return SSE2;
+#endif
+		return SCALAR;
+	}
+
+	Level activeLevel()
+	{
+		return active().level;
+	}
+
+	bool setLevel(Level level)
+	{
+		if (level > bestLevel())
+			return false;
+		active() = {level, &kernelsFor(level)};
+		return true;
+	}
+
+	const char* levelName(Level level)
+	{
+		switch (level)
+		{
+			case AVX2: return "avx2";
+			case SSE2: return "sse2";
+			default:   return "scalar";
+		}
+	}
+}
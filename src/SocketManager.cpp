@@ -15,35 +15,52 @@
 #include <cstring>
 #include <arpa/inet.h>
 #include <optional>
-#include <iostream>
-#include <cstdio>
-#include <array>
+#include <algorithm>
+#include <cerrno>
 #include "SocketManager.hpp"
 
 
 SocketManager::SocketManager() {}
 
 
-SocketManager::~SocketManager()
-{
-    for (auto& socket : _serverSockets)
-	{
-        close(socket.getFd());
-    }
-}
+// The listening Sockets close their own fds
+SocketManager::~SocketManager() {}
 /**
  * Creates a new socket for the specified port
  * Sets it to non-blocking mode
+ * SO_REUSEADDR lets a restart bind while old connections are still in TIME_WAIT
+ * With reusePort every worker binds its own listener on the same port (SO_REUSEPORT)
+ * and the kernel spreads incoming connections across them
  * Binds it to the specified port
- * Sets it to listen mode
- * Adds it to internal socket and poll descriptors collections
+ * Sets it to listen mode with the configured backlog, a port that is taken shows up as EADDRINUSE from bind
+ * Adds it to the internal socket collection, webServer::start registers it with the event loop
 */
-void SocketManager::createSocket(int port)
+void SocketManager::createSocket(int port, bool reusePort, int backlog)
 {
     try {
         Socket serverSocket(AF_INET, SOCK_STREAM, 0);
         setNonBlocking(serverSocket.getFd());
 
+        int reuse = 1;
+        if (setsockopt(serverSocket.getFd(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
+        {
+            LOG_WARN("Could not set SO_REUSEADDR for port " << port << " (" << strerror(errno) << ")");
+        }
+
+        if (reusePort)
+        {
+#ifdef SO_REUSEPORT
+            int enable = 1;
+            if (setsockopt(serverSocket.getFd(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+            {
+                LOG_ERROR("Could not set SO_REUSEPORT for port " << port << " (" << strerror(errno) << ")");
+                return;
+            }
+#else
+            LOG_WARN("SO_REUSEPORT is not supported, workers will not share port " << port);
+#endif
+        }
+
         sockaddr_in serverAddr{};
         memset(&serverAddr, 0, sizeof(serverAddr));
         serverAddr.sin_family = AF_INET;
@@ -52,84 +69,62 @@ void SocketManager::createSocket(int port)
 
         if (bind(serverSocket.getFd(), (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0)
 		{
-            std::cerr << RED("[ERROR] Could not bind socket for port " << port << " (" << strerror(errno) << ")") << std::endl;
+            if (errno == EADDRINUSE)
+                LOG_ERROR("Port " << port << " is already in use");
+            else
+                LOG_ERROR("Could not bind socket for port " << port << " (" << strerror(errno) << ")");
             return;
         }
 
-        if (listen(serverSocket.getFd(), 50) < 0)
+        if (listen(serverSocket.getFd(), backlog) < 0)
 		{
-            std::cerr << RED("[ERROR] Could not listen on socket for port " << port << " (" << strerror(errno) << ")") << std::endl;
+            LOG_ERROR("Could not listen on socket for port " << port << " (" << strerror(errno) << ")");
             return;
         }
 
         _serverSockets.push_back(std::move(serverSocket));
 
-        struct pollfd pfd{};
-        pfd.fd = _serverSockets.back().getFd();
-        pfd.events = POLLIN;
-        _pollFds.push_back(pfd);
-
-        std::cout << GREEN("[INFO] Listening on port " << port) << std::endl;
+        LOG_INFO("Listening on port " << port << " (backlog " << backlog << ")");
     }
 	catch (const std::exception& e)
 	{
-        std::cerr << e.what() << std::endl;
+        LOG_ERROR(e.what());
     }
 }
 /**
  * Accepts a new client connection on the given server socket
  * Sets the new client socket to non-blocking mode
- * Adds it to the poll descriptors with POLLIN events
- * Returns the new client file descriptor
+ * Returns the new client file descriptor, or std::nullopt once the backlog is drained
+ * The client address is stored in peer when given
 */
 
-std::optional<int> SocketManager::acceptConnection(int serverFd)
+std::optional<int> SocketManager::acceptConnection(int serverFd, struct sockaddr_storage* peer)
 {
-    int clientFd = accept(serverFd, nullptr, nullptr);
+    socklen_t peerLength = sizeof(struct sockaddr_storage);
+    struct sockaddr* address = reinterpret_cast<struct sockaddr*>(peer);
+#ifdef __linux__
+    int clientFd = accept4(serverFd, address, peer ? &peerLength : nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int clientFd = accept(serverFd, address, peer ? &peerLength : nullptr);
+#endif
     if (clientFd < 0)
     {
-        std::cerr << RED("[ERROR] Could not accept connection") << std::endl;
+        // Running out of fds is handled by the caller, it would otherwise be logged once per retry
+        int error = errno;
+        if (error != EAGAIN && error != EWOULDBLOCK && error != EMFILE && error != ENFILE)
+            LOG_ERROR("Could not accept connection (" << strerror(error) << ")");
+        errno = error;
         return std::nullopt;
     }
 
+#ifndef __linux__
     setNonBlocking(clientFd);
+#endif
 
-    auto it = std::find_if(_pollFds.begin(), _pollFds.end(), [clientFd](const pollfd &pfd)
-    {
-        return pfd.fd == clientFd;
-    });
-    if (it == _pollFds.end())
-    {
-        struct pollfd pfd{};
-        pfd.fd = clientFd;
-        pfd.events = POLLIN;
-        _pollFds.push_back(pfd);
-    }
-    else
-    {
-        std::cerr << YELLOW("[WARN] FD already in poll list: " << clientFd) << std::endl;
-    }
-
-    std::cout << GREEN("[INFO] New client connected: " << clientFd) << std::endl;
+    LOG_DEBUG("New client connected: " << clientFd);
     return clientFd;
 }
 
-void SocketManager::closeSocket(int fd)
-{
-    std::cout << BLUE("[INFO] Closing socket: " << fd) << std::endl;
-
-    _pollFds.erase( std::remove_if(_pollFds.begin(), _pollFds.end(),
-    [fd](const struct pollfd &pfd) { return pfd.fd == fd; }),_pollFds.end()
-    );
-
-    close(fd);
-}
-
-std::vector<pollfd>& SocketManager::getPollFds()
-{
-    return _pollFds;
-}
-
 std::vector<Socket>& SocketManager::getServerSockets()
 {
     return _serverSockets;
@@ -139,45 +134,23 @@ void SocketManager::setNonBlocking(int socketFd)
 {
     if (fcntl(socketFd, F_SETFL, O_NONBLOCK) == -1)
 	{
-        std::cerr << RED("[ERROR] Could not set socket to non-blocking") << std::endl;
+        LOG_ERROR("Could not set socket to non-blocking");
     }
 }
 /**
- * Uses the system's lsof command to check if a port is already in use
- * Returns the command output if the port is in use, or std::nullopt if available
- * dev/null is "black hole"—anything written to it disappears immediately, we dont care about printing anything
+ * Binds a throwaway socket without SO_REUSEPORT. It fails with EADDRINUSE if anything
+ * listens on the port, including another server whose listeners would otherwise
+ * silently share it with our SO_REUSEPORT workers.
  */
-std::optional<std::string> SocketManager::isPortAvailable(int port)
+bool SocketManager::isPortInUse(int port)
 {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::string command = "lsof -i :" + std::to_string(port) + " 2>/dev/null";
-
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe)
-	{
-        std::cerr << RED("[ERROR] Failed to run command: " << command) << std::endl;
-        return "Failed to run command";
-    }
-
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr)
-	{
-        result += buffer.data();
-    }
-
-    int exitStatus = pclose(pipe);
-    if (exitStatus == -1)
-	{
-        std::cerr << RED("[ERROR] Failed to close pipe") << std::endl;
-        return "Failed to close pipe";
-    }
-
-    std::cout << BOLD("Port " << port << " check result: " << (result.empty() ? "Available" : "In use")) << std::endl;
-
-    if (!result.empty())
-	{
-        std::cout << YELLOW("[INFO] lsof output: " << result) << std::endl;
-        return result;
-    }
-    return std::nullopt; // Port is available
+    Socket probe(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(probe.getFd(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    return bind(probe.getFd(), (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno == EADDRINUSE;
 }
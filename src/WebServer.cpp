@@ -16,35 +16,171 @@
 #include "ParseConfig.hpp"
 #include "FileUtils.hpp"
 #include "CGIHandler.hpp"
+#include "ByteRange.hpp"
 #include <vector>
 #include <dirent.h>
 #include <map>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
 
 volatile sig_atomic_t timeoutOccurred = 0;
+std::atomic<int> webServer::_formNumber{0};
+std::atomic<unsigned> webServer::_reloadGeneration{0};
+size_t webServer::_openFileBudget = SIZE_MAX;
 
 webServer::webServer(const std::unordered_multimap<std::string, std::string>& serverConfig,
-	const std::unordered_multimap<std::string, std::vector<std::string>>& locationConfig)
-	: _serverConfig(serverConfig), _locationConfig(locationConfig), _socketManager(), _cgiHandler(serverConfig)
+	const std::unordered_multimap<std::string, std::vector<std::string>>& locationConfig,
+	int workerId, int workerCount)
+	: _router(std::make_shared<const LocationRouter>()), _serverConfig(serverConfig), _locationConfig(locationConfig),
+	_workerId(workerId), _socketManager(), _cgiHandler(serverConfig)
 {
-	std::cout << BLUE("[INFO] Initializing web server...") << std::endl;
+	auto logLevelIt = _serverConfig.find("log_level");
+	if (logLevelIt != _serverConfig.end())
+		Logger::instance().setLevel(Logger::parseLevel(logLevelIt->second));
+	LOG_INFO("Initializing web server (worker " << _workerId + 1 << "/" << workerCount << ")...");
+
+	auto backendIt = _serverConfig.find("event_backend");
+	_eventLoop = EventLoop::create(backendIt != _serverConfig.end() ? backendIt->second : "");
+	LOG_INFO("Using " << _eventLoop->name() << " event backend");
+
+	try {
+		auto timeoutIt = _serverConfig.find("keepalive_timeout");
+		if (timeoutIt != _serverConfig.end())
+			_keepaliveTimeout = std::chrono::seconds(std::stoul(timeoutIt->second));
+		auto requestsIt = _serverConfig.find("keepalive_requests");
+		if (requestsIt != _serverConfig.end())
+			_keepaliveRequests = std::stoul(requestsIt->second);
+		auto headerIt = _serverConfig.find("client_header_max_size");
+		if (headerIt != _serverConfig.end())
+			_maxHeaderSize = parseConfig::parseSize(headerIt->second);
+		auto bodyBufferIt = _serverConfig.find("client_body_buffer_size");
+		if (bodyBufferIt != _serverConfig.end())
+			_bodyBufferSize = parseConfig::parseSize(bodyBufferIt->second);
+
+		size_t cacheSize = 32 * 1024 * 1024;
+		size_t cacheEntrySize = 256 * 1024;
+		auto cacheSizeIt = _serverConfig.find("file_cache_max_size");
+		if (cacheSizeIt != _serverConfig.end())
+			cacheSize = parseConfig::parseSize(cacheSizeIt->second);
+		auto cacheEntryIt = _serverConfig.find("file_cache_max_entry_size");
+		if (cacheEntryIt != _serverConfig.end())
+			cacheEntrySize = parseConfig::parseSize(cacheEntryIt->second);
+		auto cacheStatsIt = _serverConfig.find("file_cache_stats");
+		FileCache::instance().configure(cacheSize, cacheEntrySize,
+			cacheStatsIt != _serverConfig.end() && cacheStatsIt->second == "on");
+
+		size_t openFilesMax = std::min<size_t>(1000, _openFileBudget);
+		std::chrono::milliseconds openFilesValid = std::chrono::seconds(5);
+		bool openFilesErrors = true;
+		auto openMaxIt = _serverConfig.find("open_file_cache_max");
+		if (openMaxIt != _serverConfig.end())
+		{
+			openFilesMax = std::stoul(openMaxIt->second);
+			if (openFilesMax > _openFileBudget && _workerId == 0)
+				LOG_WARN("open_file_cache_max " << openFilesMax << " exceeds the " << _openFileBudget
+					<< " open files per worker that RLIMIT_NOFILE leaves room for");
+		}
+		auto openValidIt = _serverConfig.find("open_file_cache_valid");
+		if (openValidIt != _serverConfig.end())
+			openFilesValid = std::chrono::milliseconds(std::stoul(openValidIt->second) * 1000);
+		auto openErrorsIt = _serverConfig.find("open_file_cache_errors");
+		if (openErrorsIt != _serverConfig.end())
+			openFilesErrors = (openErrorsIt->second == "on");
+		_openFiles.configure(openFilesMax, openFilesValid, openFilesErrors);
+	}
+	catch (const std::exception& e)
+	{
+		throw std::runtime_error("Invalid keepalive, client_header_max_size, client_body_buffer_size, file_cache or open_file_cache directive value");
+	}
+
+	auto bodyTempIt = _serverConfig.find("client_body_temp_path");
+	if (bodyTempIt != _serverConfig.end())
+	{
+		_bodyTempPath = bodyTempIt->second;
+		if (!FileUtils::createDirectoryIfNotExists(_bodyTempPath))
+			throw std::runtime_error("Cannot create client_body_temp_path " + _bodyTempPath);
+	}
+
+	auto statusIt = _serverConfig.find("status_endpoint");
+	if (statusIt != _serverConfig.end() && statusIt->second != "off")
+		_statusPath = statusIt->second;
+
+	auto accessLogIt = _serverConfig.find("access_log");
+	if (accessLogIt != _serverConfig.end() && accessLogIt->second != "off")
+	{
+		// access_log PATH [buffer=SIZE] [flush=MS] [max_size=SIZE] [keep=N]
+		std::istringstream accessStream(accessLogIt->second);
+		std::string path;
+		std::string token;
+		size_t bufferSize = 64 * 1024;
+		std::chrono::milliseconds flushInterval(1000);
+		uint64_t maxSize = 64 * 1024 * 1024;
+		unsigned keep = 5;
+		accessStream >> path;
+		try {
+			while (accessStream >> token)
+			{
+				if (token.compare(0, 7, "buffer=") == 0)
+					bufferSize = parseConfig::parseSize(token.substr(7));
+				else if (token.compare(0, 6, "flush=") == 0)
+					flushInterval = std::chrono::milliseconds(std::stoul(token.substr(6)));
+				else if (token.compare(0, 9, "max_size=") == 0)
+					maxSize = parseConfig::parseSize(token.substr(9));
+				else if (token.compare(0, 5, "keep=") == 0)
+					keep = std::stoul(token.substr(5));
+				else
+					LOG_WARN("Unknown access_log parameter ignored: " << token);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			throw std::runtime_error("Invalid access_log directive: " + accessLogIt->second);
+		}
+		_accessLog.open(path, bufferSize, flushInterval, maxSize, keep);
+	}
 
 	for (const auto& entry : _serverConfig)
 	{
 		if (entry.first == "listen")
 		{
-			int port = std::stoi(entry.second);
+			// listen PORT [backlog=N]
+			std::istringstream listenStream(entry.second);
+			std::string token;
+			int port = 0;
+			int backlog = 511;
+			try {
+				listenStream >> token;
+				port = std::stoi(token);
+				while (listenStream >> token)
+				{
+					if (token.compare(0, 8, "backlog=") == 0)
+						backlog = std::stoi(token.substr(8));
+					else
+						LOG_WARN("Unknown listen parameter ignored: " << token);
+				}
+			}
+			catch (const std::exception& e)
+			{
+				LOG_ERROR("Invalid listen directive: " << entry.second);
+				continue;
+			}
 
-			if (auto portStatus = _socketManager.isPortAvailable(port); portStatus.has_value()) {
-				std::cerr << RED("[ERROR] Port " << port << " is already in use. Details: " << *portStatus) << std::endl;
+			// Later workers share the port with the first one on purpose, SO_REUSEPORT would also
+			// let them share it with a foreign server, so the first worker checks it is really free
+			if (_workerId == 0 && workerCount > 1 && _socketManager.isPortInUse(port))
+			{
+				LOG_ERROR("Port " << port << " is already in use");
 				continue;
 			}
 
 			try {
-				_socketManager.createSocket(port);
+				_socketManager.createSocket(port, workerCount > 1, backlog);
 			}
 			catch (const std::runtime_error& e)
 			{
-				std::cerr << RED("[ERROR] " << e.what()) << std::endl;
+				LOG_ERROR(e.what());
 				continue;
 			}
 		}
@@ -52,181 +188,634 @@ webServer::webServer(const std::unordered_multimap<std::string, std::string>& se
 
 	if (_socketManager.getServerSockets().empty())
 	{
-		std::cerr << RED("[ERROR] No valid server sockets created") << std::endl;
+		LOG_ERROR("No valid server sockets created");
 		throw std::runtime_error("No valid server sockets created");
 	}
 }
 
 void webServer::start()
 {
-	std::cout << GREEN("[SUCCESS] Server started on configured ports!") << std::endl;
+	for (auto& serverSocket : _socketManager.getServerSockets())
+	{
+		_eventLoop->add(serverSocket.getFd(), EventLoop::READ | EventLoop::EDGE,
+			EventLoop::tag(&serverSocket, EventLoop::LISTENER));
+	}
+
+	LOG_INFO("Server started on configured ports!");
+	std::vector<EventLoop::Event> events;
 	while (true)
 	{
-		int pollCount = poll(_socketManager.getPollFds().data(), _socketManager.getPollFds().size(), 500);
-		if (pollCount < 0)
+		if (_reloadSeen != _reloadGeneration.load())
 		{
-			std::cerr << RED("[ERROR] Polling failed") << std::endl;
-			continue;
+			_reloadSeen = _reloadGeneration.load();
+			LOG_INFO("Reloading error pages (worker " << _workerId + 1 << ")");
+			loadErrorPages();
 		}
 
-		for (int i = _socketManager.getPollFds().size() - 1; i >= 0; --i)
+		if (_eventLoop->wait(events, 500) < 0)
 		{
-			short revents = _socketManager.getPollFds()[i].revents; // Store revents in a local variable
+			LOG_ERROR("Polling failed");
+			continue;
+		}
 
-			if (revents & POLLIN)
+		for (const EventLoop::Event& event : events)
+		{
+			if (EventLoop::tagOf(event.data) == EventLoop::LISTENER)
 			{
-				auto it = std::find_if(
-					_socketManager.getServerSockets().begin(),
-					_socketManager.getServerSockets().end(),
-					[fd = _socketManager.getPollFds()[i].fd](const Socket& socket)
-					{
-						return socket.getFd() == fd;
-					});
-
-				if (it != _socketManager.getServerSockets().end())
-				{
-					auto clientSocketOpt = _socketManager.acceptConnection(_socketManager.getPollFds()[i].fd);
-					if (clientSocketOpt)
-					{
-						std::string serverName = it->getServerName();
-						addConnection(*clientSocketOpt, serverName);
-					}
-				}
-				else
-				{
-					processRead(_socketManager.getPollFds()[i].fd);
-				}
+				acceptConnections(*EventLoop::untag<Socket>(event.data));
+				continue;
 			}
 
-			if (revents & POLLOUT)
-			{
-				processWrite(_socketManager.getPollFds()[i].fd);
-			}
+			Connection& conn = *EventLoop::untag<Connection>(event.data);
+			if ((event.ready & EventLoop::READABLE) && !processRead(conn))
+				continue;
+			if ((event.ready & EventLoop::WRITABLE) && !processWrite(conn))
+				continue;
+			if (event.ready & (EventLoop::ERROR | EventLoop::HANGUP))
+				closeConnection(conn.socket.getFd());
+		}
+		closeIdleConnections();
+		_accessLog.tick(std::chrono::steady_clock::now());
+	}
+}
 
-			if (revents & (POLLERR | POLLHUP))
-			{
-				_socketManager.closeSocket(_socketManager.getPollFds()[i].fd);
-			}
+/**
+ * Closes connections that sat waiting for a request longer than keepalive_timeout.
+ * Runs at most once per second, so the scan cost does not grow with the request rate.
+ */
+void webServer::closeIdleConnections()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (now - _lastIdleSweep < std::chrono::seconds(1))
+		return;
+	_lastIdleSweep = now;
+
+	std::chrono::seconds timeout = std::max(_keepaliveTimeout, std::chrono::seconds(1));
+	std::vector<int> expired;
+	for (const auto& [fd, conn] : _connections)
+	{
+		if (conn.output.empty() && now - conn.lastActivity > timeout)
+			expired.push_back(fd);
+	}
+	for (int fd : expired)
+	{
+		LOG_DEBUG("Keep-alive timeout on socket: " << fd);
+		closeConnection(fd);
+	}
+
+	std::vector<Socket*> blocked = _acceptBlocked;
+	for (Socket* listener : blocked)
+		acceptConnections(*listener);
+}
+
+/**
+ * Listeners are registered edge-triggered, so drain the accept queue until it
+ * reports EAGAIN instead of taking one client per wakeup. Out of fds, the
+ * cached files are given back first. If that is not enough the queue stays
+ * as it is and no new edge would report it, so the idle sweep retries it.
+ */
+void webServer::acceptConnections(Socket& serverSocket)
+{
+	struct sockaddr_storage peer;
+	while (true)
+	{
+		std::optional<int> clientSocketOpt = _socketManager.acceptConnection(serverSocket.getFd(), &peer);
+		if (clientSocketOpt)
+		{
+			addConnection(*clientSocketOpt, serverSocket.getServerName(), peer);
+			continue;
 		}
+		if (!OpenFileCache::outOfFiles(errno))
+		{
+			_acceptBlocked.erase(std::remove(_acceptBlocked.begin(), _acceptBlocked.end(), &serverSocket), _acceptBlocked.end());
+			return;
+		}
+		// A few at a time, the cache keeps whatever the queue does not need
+		if (_openFiles.releaseFiles(16) > 0)
+			continue;
+		if (std::find(_acceptBlocked.begin(), _acceptBlocked.end(), &serverSocket) == _acceptBlocked.end())
+		{
+			LOG_WARN("Out of file descriptors, clients wait in the accept queue of socket " << serverSocket.getFd());
+			_acceptBlocked.push_back(&serverSocket);
+		}
+		return;
 	}
 }
 
-void webServer::addConnection(int clientFd, const std::string& serverName)
+void webServer::addConnection(int clientFd, const std::string& serverName, const struct sockaddr_storage& peer)
 {
 	Connection conn;
 	conn.socket = Socket(clientFd);
-	conn.requestComplete = false;
+	conn.peer = peer;
+	conn.parser.setMaxHeaderSize(_maxHeaderSize);
 	conn.serverName = serverName;
-	_connections[clientFd] = std::move(conn);
+	conn.lastActivity = std::chrono::steady_clock::now();
+	conn.acceptedAt = conn.lastActivity;
+
+	Connection& stored = _connections[clientFd] = std::move(conn);
+	if (!_eventLoop->add(clientFd, EventLoop::READ, EventLoop::tag(&stored, EventLoop::CONNECTION)))
+	{
+		_connections.erase(clientFd);
+		return;
+	}
+	_metrics.connectionOpened();
 }
 
-std::string webServer::generateResponse(const HTTPRequest& request)
+BufferChain webServer::generateResponse(const HTTPRequest& request)
 {
-	return handleRequest(request.getRawRequest());
+	return handleRequest(request);
 }
 
-void webServer::processRead(int clientSocket)
+/**
+ * Reads whatever the socket holds right now and never waits for the rest of a
+ * request. A per-wakeup budget keeps one fast uploader from starving the other
+ * clients, level-triggered readiness brings us back for the remainder.
+ * Returns false once the peer is gone and nothing is left to answer.
+ */
+bool webServer::readAvailable(Connection& conn)
 {
-	// Verify the connection exists.
-	if (_connections.find(clientSocket) == _connections.end())
-	{
-		std::cerr << RED("[ERROR] Received data for unknown client: " << clientSocket) << std::endl;
-		closeConnection(clientSocket);
-		return;
-	}
+	char buffer[4096 * 4];
+	size_t budget = 256 * 1024;
 
-	std::string fullRequest = readFullRequest(clientSocket);
-	if (fullRequest.empty())
+	while (budget > 0)
 	{
-		closeConnection(clientSocket);
-		return;
+		ssize_t bytesRead = recv(conn.socket.getFd(), buffer, sizeof(buffer), 0);
+		if (bytesRead > 0)
+		{
+			conn.inputBuffer.append(buffer, bytesRead);
+			budget -= std::min(budget, static_cast<size_t>(bytesRead));
+			if (static_cast<size_t>(bytesRead) < sizeof(buffer))
+				return true;
+		}
+		else if (bytesRead == 0)
+		{
+			if (conn.inputBuffer.empty())
+				LOG_DEBUG("Client closed connection: " << conn.socket.getFd());
+			else
+				LOG_WARN("Connection closed before full request received");
+			return false;
+		}
+		else
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
 	}
+	return true;
+}
 
-	Connection& conn = _connections[clientSocket];
-	conn.inputBuffer = fullRequest;
-
+/**
+ * Called once per request when its headers are complete: resolves the virtual
+ * server, applies the client_max_body_size of its location or server before any
+ * body byte is accepted, picks where the body is streamed to and answers
+ * Expect: 100-continue.
+ */
+void webServer::onHeadersParsed(Connection& conn, std::string_view pending)
+{
 	if (conn.serverName.empty())
 	{
-		HTTPRequest req(fullRequest);
-		std::string host = req.getHeader("Host");
+		const std::string& host = conn.parser.getHost();
 		conn.serverName = (!host.empty()) ? host : "default";
 	}
 
-	size_t maxBodySize = getClientMaxBodySize(conn.serverName);
-	if (fullRequest.size() > maxBodySize)
+	size_t requestStart = conn.parser.getRequestStart();
+	HTTPRequest head(pending.substr(requestStart, conn.parser.getHeaderLength() - requestStart));
+	const LocationConfig& location = _router->match(routePath(head.getPath()));
+	conn.parser.setBodyLimit(location.clientMaxBodySize ? *location.clientMaxBodySize : getClientMaxBodySize(conn.serverName));
+	if (conn.parser.getState() == RequestParser::FAILED)
 	{
-		std::cerr << RED("[ERROR] Request size (" << fullRequest.size() << " bytes) exceeds client_max_body_size (" << maxBodySize
-			<< " bytes) for server " << conn.serverName) << "\n";
-		std::string response = generateErrorResponse(413, "Payload Too Large");
-		sendResponse(conn.socket, response);
-		closeConnection(clientSocket);
+		LOG_ERROR("Request body exceeds client_max_body_size for server " << conn.serverName);
 		return;
 	}
 
-	std::string responseStr = handleRequest(fullRequest);
-	conn.outputBuffer = responseStr;
-	updatePollEvents(clientSocket, POLLOUT);
+	// A multipart upload is written to its files part by part, whichever framing carries it
+	conn.upload = streamUpload(head, location);
+	if (conn.upload)
+	{
+		conn.parser.setBodySink(conn.upload.get());
+	}
+	// Any other body leaves inputBuffer as it arrives, past client_body_buffer_size into a temporary file
+	else
+	{
+		conn.body = std::make_unique<RequestBody>(_bodyBufferSize, _bodyTempPath);
+		conn.parser.setBodySink(conn.body.get());
+	}
+
+	if (conn.parser.expectsContinue())
+	{
+		static const auto continueLine = std::make_shared<const std::string>("HTTP/1.1 100 Continue\r\n\r\n");
+		conn.output.append(continueLine);
+		updateEvents(conn, EventLoop::READ | EventLoop::WRITE);
+	}
+}
+
+/**
+ * A multipart POST that handleRequest would store in the upload directory gets
+ * a streaming parser as its body sink, null for every other request.
+ */
+std::unique_ptr<MultipartParser> webServer::streamUpload(const HTTPRequest& head, const LocationConfig& location)
+{
+	std::string_view path = head.getPath();
+	if (head.getMethod() != "POST" || !location.allows("POST") || location.cgiEnabled
+		|| (path != "/upload" && path.find("/upload/") != 0))
+		return nullptr;
+	std::string_view contentType = head.getHeader(HTTPRequest::CONTENT_TYPE);
+	std::string boundary;
+	if (contentType.find("multipart/form-data") == std::string_view::npos
+		|| !MultipartParser::boundaryOf(contentType, boundary))
+		return nullptr;
+
+	std::string uploadDir = getUploadDir();
+	if (!FileUtils::createDirectoryIfNotExists(uploadDir))
+		return nullptr;
+	return std::make_unique<MultipartParser>(boundary, uploadPathFor(uploadDir));
 }
 
-void webServer::processWrite(int clientSocket)
+bool webServer::processRead(Connection& conn)
 {
-	if (_connections.find(clientSocket) == _connections.end())
+	if (!readAvailable(conn))
 	{
-		std::cerr << RED("[ERROR] Trying to write to unknown client: " << clientSocket) << std::endl;
-		closeConnection(clientSocket);
-		return;
+		closeConnection(conn.socket.getFd());
+		return false;
 	}
+	conn.lastActivity = std::chrono::steady_clock::now();
 
-	Connection &conn = _connections[clientSocket];
-	if (!conn.outputBuffer.empty())
+	// Answer every complete request in the buffer, a partial next request stays for the next read
+	size_t consumed = 0;
+	while (true)
 	{
-		ssize_t bytesWritten = write(conn.socket.getFd(), conn.outputBuffer.c_str(), conn.outputBuffer.size());
+		std::string_view pending = std::string_view(conn.inputBuffer).substr(consumed);
+		if (!conn.requestPending && !pending.empty())
+		{
+			conn.requestBegin = conn.lastActivity;
+			conn.requestPending = true;
+			if (conn.requestsServed == 0)
+				_metrics.recordPhase(Metrics::ACCEPT_TO_FIRST_BYTE, conn.requestBegin - conn.acceptedAt);
+		}
+		RequestParser::State state = conn.parser.parse(pending);
+		if (conn.parser.awaitingBodyLimit())
+		{
+			onHeadersParsed(conn, pending);
+			state = conn.parser.parse(pending);
+		}
+		// Decoded chunks are in the body sink already, dropping them keeps a long upload out of inputBuffer
+		if (size_t released = conn.parser.releaseBody())
+		{
+			conn.inputBuffer.erase(consumed + conn.parser.getHeaderLength(), released);
+			pending = std::string_view(conn.inputBuffer).substr(consumed);
+		}
+		if (!conn.headersParsed && state != RequestParser::REQUEST_LINE && state != RequestParser::HEADERS
+			&& state != RequestParser::FAILED)
+		{
+			conn.headersParsed = true;
+			_metrics.recordPhase(Metrics::HEADER_PARSE, std::chrono::steady_clock::now() - conn.requestBegin);
+		}
 
-		if (bytesWritten > 0)
+		if (state == RequestParser::FAILED)
 		{
-			conn.outputBuffer.erase(0, bytesWritten);
-			if (conn.outputBuffer.empty())
-			{
-				closeConnection(clientSocket);
-			}
+			int status = conn.parser.getErrorStatus();
+			BufferChain response = generateErrorResponse(status, getStatusMessage(status));
+			conn.keepAlive = false;
+			setConnectionHeader(response, conn);
+			recordRequest(conn, nullptr, pending.size(), response);
+			conn.output.append(std::move(response));
+			conn.body.reset();
+			conn.upload.reset();
+			consumed = conn.inputBuffer.size();
+			break;
+		}
+		if (state != RequestParser::DONE)
+			break;
+
+		// The request views inputBuffer, which is only erased once every complete request is answered
+		size_t requestStart = conn.parser.getRequestStart();
+		size_t requestBytes = conn.parser.getRequestLength() - requestStart + conn.parser.getReleasedBytes();
+		std::string trailers;
+		HTTPRequest req;
+		if (conn.body || conn.upload)
+		{
+			// The body left the buffer while it arrived, handlers get its handle instead
+			req = HTTPRequest(pending.substr(requestStart, conn.parser.getHeaderLength() - requestStart));
+			trailers = conn.parser.getTrailers();
+			req.setTrailers(trailers);
+			if (conn.body)
+				req.setBody(*conn.body);
+		}
+		else
+		{
+			req = HTTPRequest(pending.substr(requestStart, requestBytes));
+		}
+		consumed += conn.parser.getRequestLength();
+		conn.parser.reset();
+
+		LOG_DEBUG("Full request received, size: " << requestBytes << " bytes");
+
+		conn.requestsServed++;
+		conn.keepAlive = wantsKeepAlive(req) && conn.requestsServed < _keepaliveRequests;
+
+		_route.location.clear();
+		_route.handlerBegin = {};
+		auto routeBegin = std::chrono::steady_clock::now();
+		_upload = conn.upload.get();
+		BufferChain response = handleRequest(req);
+		_upload = nullptr;
+		auto routeEnd = std::chrono::steady_clock::now();
+		if (_route.handlerBegin > routeBegin)
+		{
+			_metrics.recordPhase(Metrics::ROUTING, _route.handlerBegin - routeBegin);
+			_metrics.recordPhase(_route.handler, routeEnd - _route.handlerBegin);
 		}
 		else
 		{
-			std::cerr << RED("[ERROR] Failed to write to client: " << clientSocket) << std::endl;
+			_metrics.recordPhase(Metrics::ROUTING, routeEnd - routeBegin);
+		}
+
+		// Whichever handler answered, a HEAD response is the GET response without its body
+		if (req.getMethod() == "HEAD")
+		{
+			std::string_view head = response.head();
+			size_t headerEnd = head.find("\r\n\r\n");
+			if (headerEnd != std::string_view::npos && headerEnd + 4 < response.size())
+				response = BufferChain(std::string(head.substr(0, headerEnd + 4)));
+		}
+
+		setConnectionHeader(response, conn);
+		recordRequest(conn, &req, requestBytes, response);
+		conn.output.append(std::move(response));
+		conn.body.reset();
+		conn.upload.reset();
+
+		// Nothing after a closing request gets an answer
+		if (!conn.keepAlive)
+		{
+			consumed = conn.inputBuffer.size();
+			break;
+		}
+	}
+	conn.inputBuffer.erase(0, consumed);
+
+	// Stop reading until the responses are out, a client that never reads cannot grow the queue
+	if (!conn.output.empty())
+		updateEvents(conn, EventLoop::WRITE);
+	return true;
+}
+
+/**
+ * Flushes the queued responses, the chain gathers its segments into one writev
+ * and remembers how far into the front segment the socket got.
+ */
+bool webServer::processWrite(Connection& conn)
+{
+	int clientSocket = conn.socket.getFd();
+	if (conn.output.empty())
+		return true;
+
+	if (!conn.writing)
+	{
+		conn.writing = true;
+		conn.writeBegin = std::chrono::steady_clock::now();
+	}
+	ssize_t bytesWritten = conn.output.writeTo(clientSocket);
+	if (bytesWritten <= 0)
+	{
+		if (bytesWritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		LOG_ERROR("Failed to write to client: " << clientSocket);
+		closeConnection(clientSocket);
+		return false;
+	}
+
+	if (conn.output.empty())
+	{
+		conn.writing = false;
+		_metrics.recordPhase(Metrics::RESPONSE_WRITE, std::chrono::steady_clock::now() - conn.writeBegin);
+		if (!conn.keepAlive)
+		{
 			closeConnection(clientSocket);
+			return false;
 		}
+		// Responses done, wait for the next request on the same socket
+		conn.lastActivity = std::chrono::steady_clock::now();
+		updateEvents(conn, EventLoop::READ);
 	}
+	return true;
+}
+
+// HTTP/1.1 keeps the connection unless the client says close, HTTP/1.0 only when it asks for keep-alive
+bool webServer::wantsKeepAlive(const HTTPRequest& request) const
+{
+	if (_keepaliveTimeout.count() == 0)
+		return false;
+
+	std::string connection(request.getHeader(HTTPRequest::CONNECTION));
+	std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+	if (request.getVersion() == "HTTP/1.1")
+		return connection.find("close") == std::string::npos;
+	return connection.find("keep-alive") != std::string::npos;
 }
 
-void webServer::updatePollEvents(int fd, short newEvent)
+static std::string_view findResponseHeader(std::string_view head, std::string_view name)
 {
-	auto it = std::find_if(_socketManager.getPollFds().begin(), _socketManager.getPollFds().end(),
-		[fd](const struct pollfd& pfd) { return pfd.fd == fd; });
+	size_t lineStart = head.find("\r\n");
+	while (lineStart != std::string_view::npos && lineStart + 2 < head.size())
+	{
+		lineStart += 2;
+		size_t lineEnd = head.find("\r\n", lineStart);
+		if (lineEnd == std::string_view::npos)
+			lineEnd = head.size();
+		std::string_view line = head.substr(lineStart, lineEnd - lineStart);
+		if (line.size() > name.size() && line[name.size()] == ':'
+			&& std::equal(name.begin(), name.end(), line.begin(),
+				[](char a, char b) { return ::tolower(a) == ::tolower(b); }))
+		{
+			std::string_view value = line.substr(name.size() + 1);
+			value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+			return value;
+		}
+		lineStart = lineEnd;
+	}
+	return {};
+}
+
+/**
+ * Adds the Connection header right after the status line. A response the client
+ * cannot delimit (no Content-Length, not chunked, or not even HTTP) forces a close,
+ * since the end of the body is then signalled by closing the socket.
+ */
+void webServer::setConnectionHeader(BufferChain& response, Connection& conn) const
+{
+	bool& keepAlive = conn.keepAlive;
+	std::string_view front = response.head();
+	size_t headEnd = front.find("\r\n\r\n");
+	if (front.substr(0, 5) != "HTTP/" || headEnd == std::string_view::npos)
+	{
+		keepAlive = false;
+		return;
+	}
 
-	if (it != _socketManager.getPollFds().end())
+	std::string_view head = front.substr(0, headEnd + 2);
+	std::string_view existing = findResponseHeader(head, "Connection");
+	if (!existing.empty())
 	{
-		it->events = newEvent;
+		if (existing.find("close") != std::string_view::npos)
+			keepAlive = false;
+		return;
 	}
+
+	int status = std::atoi(std::string(head.substr(head.find(' ') + 1, 3)).c_str());
+	bool bodyless = (status >= 100 && status < 200) || status == 204 || status == 304;
+	if (!bodyless && findResponseHeader(head, "Content-Length").empty()
+		&& findResponseHeader(head, "Transfer-Encoding").find("chunked") == std::string_view::npos)
+	{
+		keepAlive = false;
+	}
+
+	std::string header = "Connection: close\r\n";
+	if (keepAlive)
+	{
+		header = "Connection: keep-alive\r\nKeep-Alive: timeout=" + std::to_string(_keepaliveTimeout.count())
+			+ ", max=" + std::to_string(_keepaliveRequests - conn.requestsServed) + "\r\n";
+	}
+	response.insert(head.find("\r\n") + 2, std::move(header));
 }
 
+/**
+ * Per-request bookkeeping once the response is queued: metrics counters and one
+ * fixed-size access log record, copied into this worker's buffer and written in batches.
+ */
+void webServer::recordRequest(Connection& conn, const HTTPRequest* request, uint64_t bytesIn, const BufferChain& response)
+{
+	conn.requestPending = false;
+	conn.headersParsed = false;
+
+	// A request that failed to parse is recorded without method, path and host
+	std::string_view host;
+	if (request)
+	{
+		host = request->getHeader(HTTPRequest::HOST);
+		host = host.substr(0, host.find(':'));
+	}
+	if (host.empty())
+		host = conn.serverName;
+
+	std::string_view head = response.head();
+	size_t space = head.find(' ');
+	int status = (head.substr(0, 5) == "HTTP/" && space != std::string_view::npos) ? std::atoi(head.data() + space + 1) : 0;
+	_metrics.countRequest(_metricsVhost, request ? std::string_view(_route.location) : std::string_view(), status);
+	if (_accessLog.enabled())
+	{
+		std::string_view method = request ? request->getMethod() : std::string_view();
+		std::string_view path = request ? request->getPath() : std::string_view();
+		_accessLog.record({conn.requestBegin, method, host, path, status, bytesIn, response.size(), &conn.peer});
+	}
+}
+
+void webServer::updateEvents(Connection& conn, uint32_t interest)
+{
+	_eventLoop->modify(conn.socket.getFd(), interest, EventLoop::tag(&conn, EventLoop::CONNECTION));
+}
+
+// Deregisters first, the Connection's Socket closes the fd when the entry is erased
 void webServer::closeConnection(int clientFd)
 {
-	_connections.erase(clientFd);
-	_socketManager.closeSocket(clientFd);
+	auto it = _connections.find(clientFd);
+	if (it == _connections.end())
+		return;
+
+	LOG_DEBUG("Closing socket: " << clientFd);
+	_eventLoop->remove(clientFd);
+	_connections.erase(it);
+	_metrics.connectionClosed();
 }
 
-std::string webServer::generateErrorResponse(int errorCode, const std::string& errorMessage)
+// Error responses come from memory, a flood of 404s never touches the filesystem
+BufferChain webServer::generateErrorResponse(int errorCode, const std::string& errorMessage)
 {
-	auto [errorPageContent, contentType] = HTTPResponse::getDefaultErrorPage(errorCode);
+	LOG_DEBUG("Serving error page for code: " << errorCode << " (" << errorMessage << ")");
 
-	// Generate the HTTP response
-	std::string response = "HTTP/1.1 " + std::to_string(errorCode) + " " + errorMessage + "\r\n";
+	auto it = _errorResponses.find(errorCode);
+	if (it == _errorResponses.end())
+	{
+		// A code nobody preloaded, built once and kept like the others
+		it = _errorResponses.emplace(errorCode, buildErrorPage(errorCode)).first;
+	}
+	BufferChain response;
+	response.append(it->second);
+	return response;
+}
+
+/**
+ * Builds the whole response for one status code: the page configured with error_pages
+ * if it can be read, otherwise the bundled image or the text fallback.
+ */
+std::shared_ptr<const std::string> webServer::buildErrorPage(int statusCode)
+{
+	std::string body;
+	std::string contentType;
+	auto pathIt = _errorPagePaths.find(std::to_string(statusCode));
+	if (pathIt != _errorPagePaths.end())
+	{
+		std::tie(body, contentType) = FileUtils::readFile(pathIt->second);
+		if (body.empty())
+			LOG_WARN("Error page for " << statusCode << " not readable: " << pathIt->second);
+	}
+	if (body.empty())
+		std::tie(body, contentType) = HTTPResponse::getDefaultErrorPage(statusCode);
+
+	std::string response = "HTTP/1.1 " + std::to_string(statusCode) + " " + getStatusMessage(statusCode) + "\r\n";
+	if (statusCode == 405)
+		response += "Allow: GET, POST, DELETE\r\n"; // mandatory on every 405
 	response += "Content-Type: " + contentType + "\r\n";
-	response += "Content-Length: " + std::to_string(errorPageContent.size()) + "\r\n";
+	response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
 	response += "\r\n";
-	response += errorPageContent;
+	response += body;
+	return std::make_shared<const std::string>(std::move(response));
+}
 
-	return response;
+// Every code this server produces is built up front, the old buffers stay alive while queued responses still use them
+void webServer::loadErrorPages()
+{
+	static const int statusCodes[] = {400, 403, 404, 405, 413, 414, 415, 431, 500, 501, 503, 505};
+
+	std::unordered_map<int, std::shared_ptr<const std::string>> responses;
+	for (int statusCode : statusCodes)
+		responses[statusCode] = buildErrorPage(statusCode);
+	for (const auto& [code, path] : _errorPagePaths)
+	{
+		int statusCode = std::atoi(code.c_str());
+		if (statusCode >= 400 && statusCode < 600)
+			responses[statusCode] = buildErrorPage(statusCode);
+	}
+	_errorResponses.swap(responses);
+}
+
+void webServer::setErrorPages(const std::map<std::string, std::string>& errorPages)
+{
+	_errorPagePaths = errorPages;
+}
+
+// Runs once the setters are done: builds the error responses and watches the roots for the file cache
+void webServer::warmCaches()
+{
+	loadErrorPages();
+
+	auto rootIt = _serverConfig.find("root");
+	FileCache::instance().watch(rootIt != _serverConfig.end() ? rootIt->second : "./www");
+	for (const LocationConfig& location : _router->getLocations())
+	{
+		if (!location.root.empty() && location.rootLocation == location.path)
+			FileCache::instance().watch(location.root);
+	}
+}
+
+void webServer::requestReload(int signal)
+{
+	(void)signal;
+	_reloadGeneration.fetch_add(1);
+}
+
+void webServer::setOpenFileBudget(size_t perWorker)
+{
+	_openFileBudget = perWorker;
 }
 
 std::string webServer::getStatusMessage(int statusCode)
@@ -236,33 +825,41 @@ std::string webServer::getStatusMessage(int statusCode)
 		case 200: return "OK";
 		case 201: return "Created";
 		case 204: return "No Content";
+		case 206: return "Partial Content";
+		case 304: return "Not Modified";
 		case 400: return "Bad Request";
 		case 403: return "Forbidden";
 		case 404: return "Not Found";
 		case 405: return "Method Not Allowed";
+		case 413: return "Payload Too Large";
+		case 414: return "URI Too Long";
+		case 415: return "Unsupported Media Type";
+		case 416: return "Range Not Satisfiable";
+		case 431: return "Request Header Fields Too Large";
 		case 500: return "Internal Server Error";
 		case 501: return "Not Implemented";
 		case 503: return "Service Unavailable";
+		case 505: return "HTTP Version Not Supported";
 		default:  return "Unknown Status";
 	}
 }
 
-std::unordered_map<std::string, std::string> webServer::parseHeaders(const std::string& headerSection)
+std::unordered_map<std::string, std::string> webServer::parseHeaders(std::string_view headerSection)
 {
 	std::unordered_map<std::string, std::string> headerMap;
-	std::istringstream stream(headerSection);
-	std::string line;
+	std::string_view rest = headerSection;
 
-	while (std::getline(stream, line) && line != "\r")
+	while (!rest.empty())
 	{
+		std::string_view line = scan::nextLine(rest);
+		if (line.empty())
+			break;
 		size_t colonPos = line.find(':');
-		if (colonPos != std::string::npos)
+		if (colonPos != std::string_view::npos)
 		{
-			std::string name = line.substr(0, colonPos);
-			std::string value = line.substr(colonPos + 1);
-			value.erase(0, value.find_first_not_of(" \t"));
-			value.erase(value.find_last_not_of("\r\n") + 1);
-			headerMap[name] = value;
+			std::string_view value = line.substr(colonPos + 1);
+			value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+			headerMap[std::string(line.substr(0, colonPos))] = std::string(value);
 		}
 	}
 	return headerMap;
@@ -273,36 +870,37 @@ std::string webServer::resolveFilePath(const std::string& path, const std::strin
 	std::string resolvedPath = sanitizePath(path);
 	if (resolvedPath.empty() || resolvedPath[0] != '/')
 		return "";
+	return mapToRoot(resolvedPath, _router->match(resolvedPath), rootDir);
+}
 
-	std::string matchedLocation = "";
-	std::string locationRootDir = rootDir;
-	for (const auto& [location, customRoot] : _rootDirectories)
-	{
-		if (!location.empty() && resolvedPath.find(location) == 0)
-		{
-			std::cout << BLUE("[INFO] Match found!\n");
-			if (location.length() > matchedLocation.length())
-			{
-				matchedLocation = location;
-				locationRootDir = customRoot;
-				std::cout << BLUE("[INFO] Using location '" << matchedLocation << "' with root '" << locationRootDir) << "'\n";
-			}
-		}
-	}
-
-	if (!matchedLocation.empty())
-	{
-		std::string relativePath = resolvedPath.substr(matchedLocation.size());
-		if (relativePath.empty() || relativePath[0] != '/')
-			relativePath = "/" + relativePath;
-		std::cout << BLUE("[INFO] Final path: '" << locationRootDir + relativePath) << "'\n";
-		return locationRootDir + relativePath;
-	}
+// Replaces the location that set root by that root, other paths go below the server root
+std::string webServer::mapToRoot(std::string_view path, const LocationConfig& location, const std::string& rootDir) const
+{
+	if (location.root.empty())
+		return rootDir + std::string(path);
+
+	std::string_view relativePath = path.substr(std::min(location.rootLocation.size(), path.size()));
+	std::string filePath = location.root;
+	if (relativePath.empty() || relativePath[0] != '/')
+		filePath += '/';
+	filePath += relativePath;
+	return filePath;
+}
 
-	return rootDir + resolvedPath;
+/**
+ * The path every location is matched against: query string dropped, decoded
+ * and normalized. A trailing slash is kept so "/dir/" locations still match.
+ */
+std::string webServer::routePath(std::string_view target)
+{
+	std::string decodedPath = urlDecode(target.substr(0, target.find('?')));
+	std::string path = sanitizePath(decodedPath);
+	if (path.size() > 1 && decodedPath.back() == '/')
+		path += '/';
+	return path;
 }
 
-std::string urlDecode(const std::string& encoded)
+std::string urlDecode(std::string_view encoded)
 {
 	std::string result;
 	for (size_t i = 0; i < encoded.length(); ++i)
@@ -310,7 +908,7 @@ std::string urlDecode(const std::string& encoded)
 		if (encoded[i] == '%' && i + 2 < encoded.length())
 		{
 			int value;
-			std::istringstream is(encoded.substr(i + 1, 2));
+			std::istringstream is(std::string(encoded.substr(i + 1, 2)));
 			if (is >> std::hex >> value)
 			{
 				result += static_cast<char>(value);
@@ -333,36 +931,26 @@ std::string urlDecode(const std::string& encoded)
 	return result;
 }
 
-std::string webServer::handleRequest(const std::string& fullRequest)
+BufferChain webServer::handleRequest(const HTTPRequest& httpRequest)
 {
-	if (fullRequest.empty())
+	if (httpRequest.getRawRequest().empty())
 		return generateErrorResponse(400, "Empty request");
 
-	HTTPRequest httpRequest(fullRequest);
-	std::string method = httpRequest.getMethod();
-	std::string rawPath = httpRequest.getPath();
+	std::string_view method = httpRequest.getMethod();
+	std::string_view rawPath = httpRequest.getPath();
 	std::string decodedPath = urlDecode(rawPath);
 
-	bool methodAllowed = false;
-	std::string matchedLocation = "";
+	if (!_statusPath.empty() && rawPath.substr(0, rawPath.find('?')) == _statusPath && method == "GET")
+		return generateStatusResponse(httpRequest);
 
-	for (const auto& [location, allowedMethods] : _allowedMethods)
-	{
-		if (decodedPath.find(location) == 0 && location.length() > matchedLocation.length())
-		{
-			matchedLocation = location;
-			methodAllowed = (std::find(allowedMethods.begin(), allowedMethods.end(), method) != allowedMethods.end());
-		}
-	}
+	// One walk down the location tree answers every location specific question below
+	std::string path = routePath(rawPath);
+	const LocationConfig& location = _router->match(path);
+	_route.location = location.path;
 
-	if (matchedLocation.empty())
+	if (!location.allows(method))
 	{
-		methodAllowed = true;
-	}
-
-	if (!methodAllowed)
-	{
-		std::cout << YELLOW("[INFO] Method " << method << " not allowed for path: " << decodedPath) << "\n";
+		LOG_DEBUG("Method " << method << " not allowed for path: " << decodedPath);
 		return generateMethodNotAllowedResponse();
 	}
 
@@ -384,37 +972,35 @@ std::string webServer::handleRequest(const std::string& fullRequest)
 		}
 	}
 
-	for (const auto& [location, redirection] : _redirections)
+	if (!location.redirect.empty())
 	{
-		if (rawPath.find(location) == 0 || decodedPath.find(location) == 0)
+		const std::string& redirection = location.redirect;
+		size_t spacePos = redirection.find_first_of(" \t");
+		if (spacePos != std::string::npos)
 		{
-			size_t spacePos = redirection.find_first_of(" \t");
-			if (spacePos != std::string::npos)
-			{
-				std::string statusCode = redirection.substr(0, spacePos);
-				std::string targetUrl = redirection.substr(spacePos + 1);
-				if (targetUrl.find("http://") != 0 && targetUrl.find("https://") != 0)
-					targetUrl = "http://" + targetUrl;
-				std::stringstream response;
-				response << "HTTP/1.1 " << statusCode << " Moved\r\n";
-				response << "Location: " << targetUrl << "\r\n";
-				response << "Content-Length: 0\r\n";
-				response << "\r\n";
-				std::cerr << GREEN("[INFO] Redirection successful: " << redirection) << std::endl;
-				return response.str();
-			}
-			else
-			{
-				std::cerr << RED("[ERROR] Invalid redirection format: " << redirection) << std::endl;
-			}
+			std::string statusCode = redirection.substr(0, spacePos);
+			std::string targetUrl = redirection.substr(spacePos + 1);
+			if (targetUrl.find("http://") != 0 && targetUrl.find("https://") != 0)
+				targetUrl = "http://" + targetUrl;
+			std::stringstream response;
+			response << "HTTP/1.1 " << statusCode << " Moved\r\n";
+			response << "Location: " << targetUrl << "\r\n";
+			response << "Content-Length: 0\r\n";
+			response << "\r\n";
+			LOG_DEBUG("Redirection successful: " << redirection);
+			return response.str();
+		}
+		else
+		{
+			LOG_ERROR("Invalid redirection format: " << redirection);
 		}
 	}
-	if (rawPath.find("/cgi-bin/") == 0)
+	if (location.cgiEnabled || rawPath.find("/cgi-bin/") == 0)
 	{
-		std::string scriptPath = rawPath.substr(0, rawPath.find('?'));
-		std::string queryString = rawPath.substr(rawPath.find('?') + 1);
-		std::string requestBody = httpRequest.getBody();
-		return _cgiHandler.executeCGI(scriptPath, method, queryString, requestBody);
+		std::string scriptPath(rawPath.substr(0, rawPath.find('?')));
+		std::string queryString(rawPath.substr(rawPath.find('?') + 1));
+		beginHandler(Metrics::HANDLER_CGI);
+		return _cgiHandler.executeCGI(location.cgi, scriptPath, std::string(method), queryString, httpRequest);
 	}
 
 	std::string rootDir = "./www";
@@ -425,49 +1011,29 @@ std::string webServer::handleRequest(const std::string& fullRequest)
 	}
 	if (method == "POST")
 	{
-		std::string contentType = httpRequest.getContentTypeFromHeaders("Content-Type");
+		beginHandler(Metrics::HANDLER_UPLOAD);
+		std::string contentType(httpRequest.getHeader(HTTPRequest::CONTENT_TYPE));
 		if (contentType.empty())
 			contentType = "text/plain";
 
-		if (rawPath == "/upload" || rawPath.find("/upload/") == 0)
-		{
-			if (contentType.find("multipart/form-data") != std::string::npos)
-			{
-				size_t boundaryPos = contentType.find("boundary=");
-				if (boundaryPos == std::string::npos)
-				{
-					return generateErrorResponse(400, "Missing boundary in Content-Type");
-				}
-				return generateSuccessResponse("Files uploaded successfully");
-			}
-		}
+		// The parts are in their files already, only the outcome is left to report
+		if (_upload)
+			return finishMultipartUpload(*_upload);
 		return generatePostResponse(httpRequest.getBody(), contentType);
 	}
 
-	std::string filePath = resolveFilePath(decodedPath, rootDir);
-	if (filePath.empty())
-		return generateErrorResponse(400, "Invalid path");
+	// Files are looked up without the trailing slash that was kept for matching
+	std::string_view filePart = path;
+	if (filePart.size() > 1 && filePart.back() == '/')
+		filePart.remove_suffix(1);
+	std::string filePath = mapToRoot(filePart, location, rootDir);
 
-	std::cout << BLUE("[INFO] Resolved File Path: " << filePath) << "\n";
+	LOG_DEBUG("Resolved File Path: " << filePath);
+	beginHandler(Metrics::HANDLER_STATIC);
 
-	struct stat st;
-	if (stat(filePath.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+	if (_openFiles.stat(filePath)->isDirectory)
 	{
-		bool autoindexEnabled = false;
-		std::string matchedLocation = "";
-		for (const auto& locationPair : _autoindexConfig)
-		{
-			const std::string& loc = locationPair.first;
-			if (!loc.empty() && rawPath.find(loc) == 0)
-			{
-				if (loc.length() > matchedLocation.length())
-				{
-					matchedLocation = loc;
-					autoindexEnabled = locationPair.second;
-				}
-			}
-		}
-		if (autoindexEnabled)
+		if (location.autoindex)
 		{
 			return generateDirectoryListing(filePath, decodedPath);
 		}
@@ -477,9 +1043,9 @@ std::string webServer::handleRequest(const std::string& fullRequest)
 			if (indexPath.back() != '/')
 				indexPath += "/";
 			indexPath += "index.html";
-			if (access(indexPath.c_str(), F_OK) == 0)
+			if (_openFiles.stat(indexPath)->error == 0)
 			{
-				return generateGetResponse(indexPath);
+				return generateGetResponse(indexPath, &httpRequest);
 			}
 			else
 			{
@@ -487,9 +1053,9 @@ std::string webServer::handleRequest(const std::string& fullRequest)
 			}
 		}
 	}
-	if (method == "GET")
+	if (method == "GET" || method == "HEAD")
 	{
-		return generateGetResponse(filePath);
+		return generateGetResponse(filePath, &httpRequest);
 	}
 	else if (method == "DELETE")
 	{
@@ -501,46 +1067,194 @@ std::string webServer::handleRequest(const std::string& fullRequest)
 	}
 }
 
-std::string webServer::generateGetResponse(const std::string& filePath)
+// Marks the end of routing, the rest of handleRequest is timed as this handler
+void webServer::beginHandler(Metrics::Phase handler)
+{
+	_route.handler = handler;
+	_route.handlerBegin = std::chrono::steady_clock::now();
+}
+
+// Counters and histograms of every worker, Prometheus text unless JSON is asked for
+BufferChain webServer::generateStatusResponse(const HTTPRequest& request)
 {
-	std::cout << PINK("[GET] Handling GET request for: " << filePath) << std::endl;
+	std::string_view path = request.getPath();
+	bool json = path.find("format=json", path.find('?')) != std::string_view::npos
+		|| request.getHeader("Accept").find("application/json") != std::string_view::npos;
+	if (json)
+		return HTTPResponse(200, "application/json", Metrics::renderJson()).generateChain();
+	return HTTPResponse(200, "text/plain; version=0.0.4", Metrics::renderPrometheus()).generateChain();
+}
 
-	auto [fileContent, contentType] = FileUtils::readFile(filePath);
-	if (fileContent.empty())
+// ETag and Last-Modified lines of a file response
+static std::string validatorHeaders(const OpenFileCache::FileInfo& info)
+{
+	return "ETag: " + info.etag + "\r\nLast-Modified: " + info.lastModified + "\r\n";
+}
+
+/**
+ * RFC 9110 13.2.2: If-None-Match decides when present, with the weak comparison
+ * GET and HEAD use, otherwise If-Modified-Since does. A date in another format
+ * than IMF-fixdate is ignored.
+ */
+static bool notModified(const OpenFileCache::FileInfo& info, const HTTPRequest& request)
+{
+	std::string_view ifNoneMatch = request.getHeader(HTTPRequest::IF_NONE_MATCH);
+	if (!ifNoneMatch.empty())
 	{
-		auto [defaultContent, defaultContentType] = HTTPResponse::getDefaultErrorPage(404);
-		HTTPResponse errorResponse(404, defaultContentType, defaultContent);
-		return errorResponse.generateResponse();
+		while (!ifNoneMatch.empty())
+		{
+			ifNoneMatch.remove_prefix(std::min(ifNoneMatch.find_first_not_of(" \t,"), ifNoneMatch.size()));
+			if (ifNoneMatch.substr(0, 1) == "*")
+				return true;
+			if (ifNoneMatch.substr(0, 2) == "W/")
+				ifNoneMatch.remove_prefix(2);
+			size_t end = (ifNoneMatch.substr(0, 1) == "\"") ? ifNoneMatch.find('"', 1) : ifNoneMatch.find(',');
+			end = (end == std::string_view::npos) ? ifNoneMatch.size() : end + (ifNoneMatch[0] == '"');
+			if (ifNoneMatch.substr(0, end) == info.etag)
+				return true;
+			ifNoneMatch.remove_prefix(end);
+		}
+		return false;
 	}
+	std::string_view ifModifiedSince = request.getHeader(HTTPRequest::IF_MODIFIED_SINCE);
+	time_t since;
+	return !ifModifiedSince.empty() && HTTPResponse::parseHttpDate(ifModifiedSince, since) && info.mtime.tv_sec <= since;
+}
 
-	std::cout << PINK("[GET] Serving file: " << filePath << " ("
-			<< fileContent.size() << " bytes, " << contentType << ")") << std::endl;
+BufferChain webServer::generateGetResponse(const std::string& filePath, const HTTPRequest* request)
+{
+	LOG_DEBUG("[GET] Handling GET request for: " << filePath);
+
+	// Revalidations and HEAD are answered from the metadata, without opening the file
+	std::shared_ptr<const OpenFileCache::FileInfo> metadata = _openFiles.stat(filePath);
+	if (metadata->error || metadata->isDirectory)
+		return generateErrorResponse(404, "Not Found");
+	if (request && notModified(*metadata, *request))
+		return BufferChain("HTTP/1.1 304 " + getStatusMessage(304) + "\r\n" + validatorHeaders(*metadata) + "\r\n");
+	if (request && request->getMethod() == "HEAD")
+		return BufferChain(HTTPResponse::generateHeaders(200, *metadata->contentType, metadata->size, validatorHeaders(*metadata)));
+
+	// Ranges are cut from the open file, the shared cache only holds complete responses
+	bool ranged = request && request->getMethod() == "GET" && !request->getHeader(HTTPRequest::RANGE).empty();
+	FileCache& cache = FileCache::instance();
+	std::shared_ptr<const FileCache::CachedFile> cached = ranged ? nullptr : cache.lookup(filePath);
+	if (cached)
+	{
+		LOG_DEBUG("[GET] Serving cached file: " << filePath << " ("
+				<< cached->bodySize << " bytes, " << cached->contentType->name << ")");
+		BufferChain response;
+		response.append(cached->response);
+		return response;
+	}
+	uint64_t generation = cache.generation(filePath);
 
-	HTTPResponse response(200, contentType, std::string(fileContent.data(), fileContent.size()));
-	return response.generateResponse();
+	std::shared_ptr<const OpenFileCache::FileInfo> info = _openFiles.get(filePath);
+	// Filling the shared cache needs the current file, not whatever the open fd pointed at when it was cached
+	if (info->file && cache.cacheable(filePath, info->size))
+		info = _openFiles.get(filePath, true);
+	if (!info->file)
+	{
+		return generateErrorResponse(404, "Not Found");
+	}
+
+	LOG_DEBUG("[GET] Serving file: " << filePath << " ("
+			<< info->size << " bytes, " << info->contentType->name << ")");
+	if (ranged)
+	{
+		if (std::optional<BufferChain> partial = generateRangeResponse(*info, *request))
+			return std::move(*partial);
+	}
+
+	// Small files are read once into a complete response that later requests share
+	if (cache.cacheable(filePath, info->size))
+	{
+		std::string serialized = HTTPResponse::generateHeaders(200, *info->contentType, info->size, validatorHeaders(*info));
+		size_t headerSize = serialized.size();
+		serialized.resize(headerSize + info->size);
+		if (FileUtils::readAll(info->file->getFd(), serialized.data() + headerSize, info->size))
+		{
+			auto cached = std::make_shared<FileCache::CachedFile>();
+			cached->response = std::make_shared<const std::string>(std::move(serialized));
+			cached->contentType = info->contentType;
+			cached->bodySize = info->size;
+			cache.insert(filePath, cached, generation);
+
+			BufferChain response;
+			response.append(cached->response);
+			return response;
+		}
+	}
+
+	// Only the headers are built in memory, the body is sent from the open file in bounded chunks
+	BufferChain response(HTTPResponse::generateHeaders(200, *info->contentType, info->size, validatorHeaders(*info)));
+	response.append(info->file, 0, info->size);
+	return response;
+}
+
+/**
+ * 206 for a satisfiable Range, 416 when no range overlaps the file, nothing when
+ * Range is to be ignored and the whole file is sent. Every range is a region of
+ * the open file, so the bytes in front of it are never read.
+ */
+std::optional<BufferChain> webServer::generateRangeResponse(const OpenFileCache::FileInfo& info, const HTTPRequest& request)
+{
+	// If-Range: the ranges only apply to the version of the file the client already holds part of
+	std::string_view ifRange = request.getHeader(HTTPRequest::IF_RANGE);
+	if (!ifRange.empty() && ifRange != info.etag && ifRange != info.lastModified)
+		return std::nullopt;
+
+	std::vector<byterange::Range> ranges;
+	byterange::Result result = byterange::parse(request.getHeader(HTTPRequest::RANGE), info.size, ranges);
+	if (result == byterange::IGNORED)
+		return std::nullopt;
+	std::string completeLength = "/" + std::to_string(info.size) + "\r\n";
+	if (result == byterange::UNSATISFIABLE)
+		return BufferChain("HTTP/1.1 416 " + getStatusMessage(416) + "\r\nContent-Range: bytes *" + completeLength + "Content-Length: 0\r\n\r\n");
+
+	auto contentRange = [&](const byterange::Range& range) {
+		return "Content-Range: bytes " + std::to_string(range.first) + "-"
+			+ std::to_string(range.first + range.length - 1) + completeLength;
+	};
+	if (ranges.size() == 1)
+	{
+		BufferChain response("HTTP/1.1 206 " + getStatusMessage(206) + "\r\n" + info.contentType->headerLine + validatorHeaders(info)
+			+ "Accept-Ranges: bytes\r\n" + contentRange(ranges[0]) + "Content-Length: " + std::to_string(ranges[0].length) + "\r\n\r\n");
+		response.append(info.file, ranges[0].first, ranges[0].length);
+		return response;
+	}
+
+	// Several ranges go out as multipart/byteranges, each part framed by a boundary and its own Content-Range
+	static std::atomic<uint64_t> boundaryCounter{0};
+	std::ostringstream boundary;
+	boundary << std::setw(20) << std::setfill('0') << ++boundaryCounter;
+	BufferChain parts;
+	for (const byterange::Range& range : ranges)
+	{
+		parts.append("\r\n--" + boundary.str() + "\r\n" + info.contentType->headerLine + contentRange(range) + "\r\n");
+		parts.append(info.file, range.first, range.length);
+	}
+	parts.append("\r\n--" + boundary.str() + "--\r\n");
+
+	BufferChain response("HTTP/1.1 206 " + getStatusMessage(206) + "\r\nContent-Type: multipart/byteranges; boundary=" + boundary.str()
+		+ "\r\n" + validatorHeaders(info) + "Accept-Ranges: bytes\r\nContent-Length: " + std::to_string(parts.size()) + "\r\n\r\n");
+	response.append(std::move(parts));
+	return response;
 }
 
 
 std::string webServer::getCurrentTimeString()
 {
-	_formNumber++;
-	return std::to_string(_formNumber);
+	return std::to_string(++_formNumber);
 }
 
-std::string webServer::generatePostResponse(const std::string& requestBody, const std::string& contentType)
+BufferChain webServer::generatePostResponse(std::string_view requestBody, const std::string& contentType)
 {
 
-	std::cout << BLUE("[INFO] Processing POST request") << std::endl;
-	std::cout << BLUE("[INFO] Content-Type: " << contentType) << std::endl;
-	std::cout << BLUE("[INFO] Request body size: " << requestBody.size() << " bytes") << std::endl;
-
-	std::string uploadDir = "./www/html/upload";
-	auto it = _serverConfig.find("upload_dir");
-	if (it != _serverConfig.end())
-	{
-		uploadDir = it->second;
-	}
+	LOG_DEBUG("Processing POST request");
+	LOG_DEBUG("Content-Type: " << contentType);
+	LOG_DEBUG("Request body size: " << requestBody.size() << " bytes");
 
+	std::string uploadDir = getUploadDir();
 	if (!FileUtils::createDirectoryIfNotExists(uploadDir))
 	{
 		return generateErrorResponse(500, "Server configuration error");
@@ -559,129 +1273,109 @@ std::string webServer::generatePostResponse(const std::string& requestBody, cons
 	}
 	else
 	{
-		std::cerr << "[ERROR] Unsupported content type: " << contentType << std::endl;
-		std::cout << "Received Content-Type: " << contentType << std::endl;
+		LOG_ERROR("Unsupported content type: " << contentType);
 		return generateErrorResponse(415, "Unsupported Media Type");
 	}
 }
 
-std::string webServer::handleMultipartUpload(const std::string& requestBody,
+BufferChain webServer::handleMultipartUpload(std::string_view requestBody,
 	const std::string& contentType,
 	const std::string& uploadDir)
 {
-	std::cout << BLUE("[INFO] Processing multipart/form-data upload") << std::endl;
+	LOG_DEBUG("Processing multipart/form-data upload");
 
-	// Extract boundary from Content-Type header
 	std::string boundary;
-	size_t boundaryPos = contentType.find("boundary=");
-	if (boundaryPos == std::string::npos)
+	if (!MultipartParser::boundaryOf(contentType, boundary))
 	{
-		std::cerr << RED("[ERROR] No boundary found in Content-Type") << std::endl;
+		LOG_ERROR("No boundary found in Content-Type");
 		return generateErrorResponse(400, "Missing boundary in multipart/form-data");
 	}
 
-	boundary = contentType.substr(boundaryPos + 9);
-	if (boundary.front() == '"' && boundary.back() == '"')
-	{
-		boundary = boundary.substr(1, boundary.size() - 2);
-	}
-
-	std::string fullBoundary = "--" + boundary;
-
-	size_t boundaryStart = requestBody.find(fullBoundary);
-	if (boundaryStart == std::string::npos)
-	{
-		std::cerr << RED("[ERROR] Could not find boundary in request body") << std::endl;
-		return generateErrorResponse(400, "Malformed multipart/form-data");
-	}
-
-	size_t headersStart = boundaryStart + fullBoundary.length();
-	if (headersStart >= requestBody.size())
-	{
-		std::cerr << RED("[ERROR] Headers section not found") << std::endl;
-		return generateErrorResponse(400, "Malformed multipart/form-data");
-	}
-
-	if (requestBody[headersStart] == '\r' && headersStart + 1 < requestBody.size() && requestBody[headersStart + 1] == '\n')
-	{
-		headersStart += 2;
-	}
+	MultipartParser upload(boundary, uploadPathFor(uploadDir));
+	upload.write(requestBody);
+	return finishMultipartUpload(upload);
+}
 
-	size_t headersEnd = requestBody.find("\r\n\r\n", headersStart);
-	if (headersEnd == std::string::npos)
+// One line per part, file parts name the file they were saved as
+BufferChain webServer::finishMultipartUpload(MultipartParser& upload)
+{
+	if (!upload.finish())
 	{
-		std::cerr << RED("[ERROR] End of headers not found") << std::endl;
-		return generateErrorResponse(400, "Malformed multipart/form-data");
+		int status = upload.getErrorStatus();
+		LOG_ERROR("Multipart upload failed with status " << status);
+		return generateErrorResponse(status, status == 400 ? "Malformed multipart/form-data" : "Failed to save file");
 	}
 
-	std::string headers = requestBody.substr(headersStart, headersEnd - headersStart);
-	std::cout << BLUE("[INFO] Headers: " << headers) << std::endl;
-
-	std::string filename = "uploaded_file_" + getCurrentTimeString() + ".bin";
-	size_t filenamePos = headers.find("filename=\"");
-	if (filenamePos != std::string::npos)
-	{
-		size_t start = filenamePos + 10;
-		size_t end = headers.find("\"", start);
-		if (end != std::string::npos)
+	// Names come from the client, quotes inside them are escaped
+	auto quoted = [](const std::string& value) {
+		std::string text = "\"";
+		for (char c : value)
 		{
-			filename = sanitizeFilename(headers.substr(start, end - start));
-			std::cout << BLUE("[INFO] Filename: " << filename) << std::endl;
+			if (c == '"' || c == '\\')
+				text += '\\';
+			text += c;
 		}
-	}
-
-	size_t contentStart = headersEnd + 4;
-
-	size_t nextBoundary = requestBody.find(fullBoundary, contentStart);
-	if (nextBoundary == std::string::npos)
-	{
-		std::cerr << RED("[ERROR] Closing boundary not found") << std::endl;
-		return generateErrorResponse(400, "Malformed multipart/form-data");
-	}
-
-	size_t contentEnd = nextBoundary;
-	if (contentEnd > 2 && requestBody[contentEnd - 2] == '\r' && requestBody[contentEnd - 1] == '\n')
-	{
-		contentEnd -= 2;
-	}
-
-	std::string content = requestBody.substr(contentStart, contentEnd - contentStart);
-	std::cout << BLUE("[INFO] Content size: " << content.size() << " bytes") << std::endl;
-
-	std::string filePath = uploadDir + "/" + filename;
-	std::cout << BLUE("[INFO] Saving file to: " << filePath) << std::endl;
-
-	if (!FileUtils::writeFile(filePath, content))
+		return text + "\"";
+	};
+	const std::vector<MultipartParser::Part>& parts = upload.getParts();
+	std::ostringstream responseText;
+	responseText << "Uploaded " << parts.size() << (parts.size() == 1 ? " part\n" : " parts\n");
+	for (const MultipartParser::Part& part : parts)
 	{
-		return generateErrorResponse(500, "Failed to save file");
+		responseText << "name=" << quoted(part.name);
+		if (part.isFile)
+		{
+			std::string savedAs = part.savedAs.substr(part.savedAs.find_last_of('/') + 1);
+			responseText << " filename=" << quoted(part.filename) << " saved-as=" << quoted(savedAs);
+			_openFiles.invalidate(part.savedAs);
+			LOG_INFO("[POST] File saved: " << savedAs << " (" << part.size << " bytes)");
+		}
+		responseText << " content-type=" << quoted(part.contentType) << " size=" << part.size << "\n";
 	}
+	return HTTPResponse(201, "text/plain", responseText.str()).generateResponse();
+}
 
-	std::cout << PINK("[POST] File saved: " << filename) << std::endl;
+// Client file names are reduced to a safe set of characters, names made of dots only are replaced
+MultipartParser::PathFor webServer::uploadPathFor(const std::string& uploadDir)
+{
+	return [this, uploadDir](const MultipartParser::Part& part) {
+		std::string filename = sanitizeFilename(part.filename);
+		if (filename.find_first_not_of('.') == std::string::npos)
+			filename = "uploaded_file_" + getCurrentTimeString() + ".bin";
+		std::string filePath = uploadDir + "/" + filename;
+		LOG_DEBUG("Saving file to: " << filePath);
+		_openFiles.invalidate(filePath);
+		return filePath;
+	};
+}
 
-	std::string responseText = "File uploaded successfully: " + filename;
-	return HTTPResponse(201, "text/plain", responseText).generateResponse();
+std::string webServer::getUploadDir() const
+{
+	auto it = _serverConfig.find("upload_dir");
+	return (it != _serverConfig.end()) ? it->second : "./www/html/upload";
 }
 
-std::string webServer::handleFormUrlEncodedUpload(const std::string& requestBody,
+BufferChain webServer::handleFormUrlEncodedUpload(std::string_view requestBody,
 	const std::string& uploadDir)
 {
 	std::string filename = "form_data_" + getCurrentTimeString() + ".txt";
 	std::string filePath = uploadDir + "/" + filename;
 
-	std::cout << BLUE("[INFO] Saving form data to: " << filePath) << std::endl;
+	LOG_DEBUG("Saving form data to: " << filePath);
 
+	_openFiles.invalidate(filePath);
 	if (!FileUtils::writeFile(filePath, requestBody))
 	{
 		return generateErrorResponse(500, "Failed to save file");
 	}
 
-	std::cout << PINK("[POST] Form data saved: " << filename) << std::endl;
+	LOG_INFO("[POST] Form data saved: " << filename);
 
 	std::string responseText = "Form data uploaded successfully: " + filename;
 	return HTTPResponse(201, "text/plain", responseText).generateResponse();
 }
 
-std::string webServer::generateDeleteResponse(const std::string& filePath)
+BufferChain webServer::generateDeleteResponse(const std::string& filePath)
 {
 	std::string adjustedFilePath;
 	const std::string marker = "/upload/";
@@ -697,6 +1391,8 @@ std::string webServer::generateDeleteResponse(const std::string& filePath)
 		adjustedFilePath = filePath;
 	}
 
+	_openFiles.invalidate(filePath);
+	_openFiles.invalidate(adjustedFilePath);
 	if (!FileUtils::deleteFile(adjustedFilePath))
 	{
 		return generateErrorResponse(500, "Failed to delete file");
@@ -717,12 +1413,13 @@ void webServer::sendResponse(Socket& clientSocket, const std::string& response)
 
 		if (bytesWritten < 0)
 		{
-			std::cerr << RED("[ERROR] Error sending response to client (write failed)") << std::endl;
+			LOG_ERROR("Error sending response to client (write failed)");
 			closeConnection(clientSocket.getFd());
+			return;
 		}
 		else if (bytesWritten == 0)
 		{
-			std::cerr << YELLOW("[INFO] Connection closed by peer during write") << std::endl;
+			LOG_DEBUG("Connection closed by peer during write");
 			closeConnection(clientSocket.getFd());
 			return;
 		}
@@ -731,20 +1428,9 @@ void webServer::sendResponse(Socket& clientSocket, const std::string& response)
 	}
 }
 
-std::string webServer::generateMethodNotAllowedResponse()
+BufferChain webServer::generateMethodNotAllowedResponse()
 {
-	auto [errorContent, errorContentType] = HTTPResponse::getDefaultErrorPage(405);
-
-	std::stringstream response;
-	response << "HTTP/1.1 405 Method Not Allowed\r\n";
-	response << "Content-Type: " << errorContentType << "\r\n";
-	response << "Content-Length: " << errorContent.size() << "\r\n";
-	response << "Allow: GET, POST, DELETE\r\n";
-	response << "Connection: close\r\n";
-	response << "\r\n";
-
-	response.write(errorContent.data(), errorContent.size());
-	return response.str();
+	return generateErrorResponse(405, "Method Not Allowed");
 }
 
 std::string webServer::getFilePath(const std::string& path)
@@ -757,12 +1443,12 @@ std::string webServer::getFilePath(const std::string& path)
 	return basePath + path;
 }
 
-std::string webServer::generateDirectoryListing(const std::string& directoryPath, const std::string& requestPath)
+BufferChain webServer::generateDirectoryListing(const std::string& directoryPath, const std::string& requestPath)
 {
 	DIR* dir = opendir(directoryPath.c_str());
 	if (!dir)
 	{
-		std::cerr << "[ERROR] Failed to open directory: " << directoryPath << "\n";
+		LOG_ERROR("Failed to open directory: " << directoryPath);
 		return generateErrorResponse(500, "Failed to open directory");
 	}
 
@@ -794,22 +1480,30 @@ std::string webServer::generateDirectoryListing(const std::string& directoryPath
 	return httpResponse.str();
 }
 
-void webServer::setAutoindexConfig(const std::map<std::string, bool>& autoindexConfig)
+void webServer::setRouter(std::shared_ptr<const LocationRouter> router)
 {
-	_autoindexConfig = autoindexConfig;
-}
-void webServer::setRedirections(const std::map<std::string, std::string>& redirections)
-{
-	_redirections = redirections;
+	_router = std::move(router);
 }
+// Metrics are labelled with the block's configured name, so a client cannot add series by inventing Hosts
 void webServer::setServerNames(const std::map<std::string, std::string>& serverNames)
 {
 	_serverNames = serverNames;
+	_metricsVhost = "default";
+	for (const auto& [serverBlock, names] : serverNames)
+	{
+		std::istringstream stream(names);
+		std::string first;
+		if (stream >> first)
+		{
+			_metricsVhost = first;
+			break;
+		}
+	}
 }
 void webServer::setClientMaxBodySize(const std::string& serverName, size_t size)
 {
 	_clientMaxBodySizes[serverName] = size;
-	std::cout << BLUE("[INFO] Set client_max_body_size for server '" << serverName << "' to " << size << " bytes\n");
+	LOG_INFO("Set client_max_body_size for server '" << serverName << "' to " << size << " bytes");
 }
 
 size_t webServer::getClientMaxBodySize(const std::string& serverName) const
@@ -833,11 +1527,11 @@ size_t webServer::getClientMaxBodySize(const std::string& serverName) const
 	it = _clientMaxBodySizes.find("localhost");
 	if (it != _clientMaxBodySizes.end())
 	{
-		std::cout << BLUE("[INFO] Found client_max_body_size for 'localhost': " << it->second << " bytes\n");
+		LOG_DEBUG("Found client_max_body_size for 'localhost': " << it->second << " bytes");
 		return it->second;
 	}
 
-	std::cout << BLUE("[INFO] Using default client_max_body_size for server '" << serverName << "': 1048576 bytes\n");
+	LOG_DEBUG("Using default client_max_body_size for server '" << serverName << "': 1048576 bytes");
 	return 1048576;
 }
 
@@ -851,15 +1545,15 @@ size_t webServer::getContentLength(const std::unordered_map<std::string, std::st
 		}
 		catch (const std::exception& e)
 		{
-			std::cerr << RED("[ERROR] Invalid Content-Length value: " << e.what()) << std::endl;
+			LOG_ERROR("Invalid Content-Length value: " << e.what());
 		}
 	}
 	return 0;
 }
-std::string webServer::handleTextUpload(const std::string& requestBody,
+BufferChain webServer::handleTextUpload(std::string_view requestBody,
 	const std::string& uploadDir)
 {
-	std::cout << BLUE("[INFO] Processing plain text upload") << std::endl;
+	LOG_DEBUG("Processing plain text upload");
 
 	std::unordered_map<std::string, std::string> headers = parseHeaders(requestBody);
 	std::string filename = "text_data_" + getCurrentTimeString() + ".txt";
@@ -875,117 +1569,27 @@ std::string webServer::handleTextUpload(const std::string& requestBody,
 			if (end != std::string::npos)
 			{
 				filename = sanitizeFilename(disposition.substr(start, end - start));
-				std::cout << BLUE("[INFO] Original filename extracted: " << filename) << std::endl;
+				LOG_DEBUG("Original filename extracted: " << filename);
 			}
 		}
 	}
 
 	std::string filePath = uploadDir + "/" + filename;
-	std::cout << PINK("[POST] Saving text data to: " << filePath) << std::endl;
+	LOG_DEBUG("[POST] Saving text data to: " << filePath);
 
+	_openFiles.invalidate(filePath);
 	if (!FileUtils::writeFile(filePath, requestBody))
 	{
 		return generateErrorResponse(500, "Failed to save file");
 	}
 
-	std::cout << PINK("[POST] Text data saved: " << filename) << std::endl;
+	LOG_INFO("[POST] Text data saved: " << filename);
 
 	std::string responseText = "Text data uploaded successfully: " + filename;
 	return HTTPResponse(201, "text/plain", responseText).generateResponse();
 }
 
-std::string webServer::readFullRequest(int clientSocket)
-{
-	std::string request;
-	request.reserve(10 * 1024 * 1024);
-	char buffer[4096 * 4];
-	ssize_t bytesRead;
-	bool headersComplete = false;
-	size_t contentLength = 0;
-	size_t totalRead = 0;
-
-	// Read headers
-	while (!headersComplete)
-	{
-		bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
-		if (bytesRead < 0)
-		{
-			return "";
-		}
-		else if (bytesRead == 0)
-		{
-			if (request.empty())
-			{
-				std::cerr << RED("[ERROR] Connection closed before any data received") << std::endl;
-				return "";
-			}
-			break;
-		}
-		request.append(buffer, bytesRead);
-
-		// Check for end of headers
-		size_t headersEnd = request.find("\r\n\r\n");
-		if (headersEnd != std::string::npos)
-		{
-			headersComplete = true;
-			size_t headerEndIndex = headersEnd + 4;
-
-			std::string headerSection = request.substr(0, headersEnd);
-			auto headers = parseHeaders(headerSection);
-
-			auto expectIt = headers.find("Expect");
-			if (expectIt != headers.end() && expectIt->second == "100-continue")
-			{
-				const char* continueResponse = "HTTP/1.1 100 Continue\r\n\r\n";
-				if (send(clientSocket, continueResponse, strlen(continueResponse), 0) <= 0)
-				{
-					std::cerr << RED("[ERROR] Error sending 100-continue response\n");
-					return "";
-				}
-			}
-			contentLength = getContentLength(headers);
-			totalRead = request.size() - headerEndIndex;
-
-			size_t maxBodySize = 0;
-			auto hostIt = headers.find("Host");
-			if (hostIt != headers.end())
-			{
-				maxBodySize = getClientMaxBodySize(hostIt->second);
-			}
-
-			if (contentLength > maxBodySize)
-			{
-				std::cerr << RED("[ERROR] Request size (" << contentLength << " bytes) exceeds client_max_body_size (" << maxBodySize << " bytes)\n");
-				std::string response = generateErrorResponse(413, "Payload Too Large");
-				Socket clientSock(clientSocket);
-				sendResponse(clientSock, response);
-				return "";
-			}
-		}
-	}
-	while (totalRead < contentLength)
-	{
-		size_t toRead = std::min(sizeof(buffer), contentLength - totalRead);
-		bytesRead = recv(clientSocket, buffer, toRead, 0);
-		if (bytesRead < 0)
-		{
-			continue;
-		}
-		else if (bytesRead == 0)
-		{
-			std::cerr << RED("[ERROR] Connection closed before full body received") << std::endl;
-			return "";
-		}
-		request.append(buffer, bytesRead);
-		totalRead += bytesRead;
-	}
-
-	std::cout << GREEN("[INFO] Full request received, size: " << request.size() << " bytes") << std::endl;
-
-	return request;
-}
-
-std::string webServer::generateSuccessResponse(const std::string& message)
+BufferChain webServer::generateSuccessResponse(const std::string& message)
 {
 	std::stringstream response;
 	response << "HTTP/1.1 200 OK\r\n";
@@ -996,26 +1600,6 @@ std::string webServer::generateSuccessResponse(const std::string& message)
 	return response.str();
 }
 
-void webServer::setRootDirectories(const std::map<std::string, std::string>& rootDirectories)
-{
-	_rootDirectories = rootDirectories;
-}
-
-std::vector<std::string> webServer::getAllowedMethods(const std::string& location) const
-{
-	auto it = _allowedMethods.find(location);
-	if (it != _allowedMethods.end())
-	{
-		return it->second;
-	}
-	return {};
-}
-
-void webServer::setAllowedMethods(const std::map<std::string, std::vector<std::string>>& allowedMethods)
-{
-	_allowedMethods = allowedMethods;
-}
-
 CGIHandler& webServer::getCGIHandler()
 {
 	return _cgiHandler;
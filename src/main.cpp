@@ -14,12 +14,54 @@
 #include "WebServer.hpp"
 #include "Utils.hpp"
 #include "CGIHandler.hpp"
+#include "Colors.hpp"
+#include "MimeTypes.hpp"
 #include <thread>
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <sys/resource.h>
+
+/**
+ * Connections and cached open files of every worker share one fd limit. The soft
+ * limit is raised to the hard one, half of it stays free for connections, CGI
+ * pipes and logs and the other half is split into the open file caches.
+ */
+static void budgetFileDescriptors(int totalWorkers)
+{
+	struct rlimit files;
+	if (getrlimit(RLIMIT_NOFILE, &files) < 0)
+		return;
+	if (files.rlim_cur < files.rlim_max)
+	{
+		rlim_t soft = files.rlim_cur;
+		files.rlim_cur = files.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &files) < 0)
+			files.rlim_cur = soft;
+	}
+	if (files.rlim_cur == RLIM_INFINITY)
+		return;
+
+	size_t perWorker = files.rlim_cur / 2 / std::max(totalWorkers, 1);
+	webServer::setOpenFileBudget(perWorker);
+	LOG_INFO("File descriptor limit " << files.rlim_cur << ", up to " << std::min<size_t>(perWorker, 1000)
+		<< " cached open files per worker by default");
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
 int main(int argc, char** argv)
 {
+	auto startupBegin = std::chrono::steady_clock::now();
+	double parseTime = 0;
+	double socketTime = 0;
+	double cacheTime = 0;
+
 	std::string filename;
 	if (argc > 2)
 	{
@@ -34,63 +76,106 @@ int main(int argc, char** argv)
 	std::ifstream file(filename);
 	if (!file.is_open())
 	{
-		std::cerr << RED("[ERROR] Could not open configuration file: " << filename) << std::endl;
+		LOG_ERROR("Could not open configuration file: " << filename);
 		return 1;
 	}
 
+	// A client that resets mid-response must fail the write with EPIPE, not kill the server
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGHUP, webServer::requestReload);
+
+	auto phaseStart = std::chrono::steady_clock::now();
 	std::vector<parseConfig> parser = splitServers(file);
 	file.close();
+	parseTime += millisecondsSince(phaseStart);
 
-	std::vector<std::thread> threads;
-
+	// Every block is parsed before the first worker starts, the MIME table they share is compiled once from all of them
+	phaseStart = std::chrono::steady_clock::now();
+	std::vector<bool> parsed(parser.size(), false);
+	int totalWorkers = 0;
+	std::string charset;
+	MimeTypes& mimeTypes = MimeTypes::instance();
 	for (size_t j = 0; j < parser.size(); j++)
 	{
 		try
 		{
 			parser[j].parse(parser[j]._mainString);
+			// The charset lives in the shared MIME table, so a block may only repeat the one already set
+			auto charsetIt = parser[j]._parsingServer.find("charset");
+			if (charsetIt != parser[j]._parsingServer.end())
+			{
+				if (!charset.empty() && charsetIt->second != charset)
+					throw std::runtime_error("charset " + charsetIt->second + " conflicts with charset " + charset
+						+ " of an earlier server block, charset applies to all server blocks");
+				charset = charsetIt->second;
+			}
+			for (const auto& [type, extension] : parser[j].getMimeTypes())
+				mimeTypes.add(type, extension);
+			totalWorkers += parser[j].getWorkerCount();
+			parsed[j] = true;
+		}
+		catch (const std::exception& e)
+		{
+			LOG_ERROR("Error starting server: " << e.what());
+		}
+	}
+	if (!charset.empty())
+		mimeTypes.setCharset(charset);
+	mimeTypes.compile();
+	LOG_DEBUG("MIME table: " << mimeTypes.getTypeCount() << " extensions in " << mimeTypes.getSlotCount() << " slots");
+	parseTime += millisecondsSince(phaseStart);
+	budgetFileDescriptors(totalWorkers);
 
-			std::shared_ptr<webServer> server = std::make_shared<webServer>(
-				parser[j]._parsingServer, parser[j]._parsingLocation);
+	std::vector<std::thread> threads;
 
-			server->setAutoindexConfig(parser[j]._autoindexConfig);
-			server->setRedirections(parser[j].getRedirections());
-			server->setServerNames(parser[j].getServerNames());
-			server->setRootDirectories(parser[j].getRootDirectories());
-			server->setAllowedMethods(parser[j].getAllowedMethods());
+	for (size_t j = 0; j < parser.size(); j++)
+	{
+		if (!parsed[j])
+			continue;
+		try
+		{
+			int workerCount = parser[j].getWorkerCount();
 
-			std::map<std::string, CGIHandler::CGIConfig> webServerCGIConfig;
-			const auto& parserCGIConfig = parser[j].getCGIConfigs();
+			// Compiled once per server block, every worker routes through the same immutable tree
+			std::shared_ptr<const LocationRouter> router = std::make_shared<const LocationRouter>(parser[j].getLocationDirectives());
 
-			for (const auto& [location, config] : parserCGIConfig)
+			// One independent event loop per worker, each with its own SO_REUSEPORT listeners
+			for (int worker = 0; worker < workerCount; worker++)
 			{
-				CGIHandler::CGIConfig serverConfig;
-				serverConfig.cgiPass = config.cgiPass;
-				serverConfig.scriptFilename = config.scriptFilename;
-				serverConfig.pathInfo = config.pathInfo;
-				serverConfig.queryString = config.queryString;
-				serverConfig.requestMethod = config.requestMethod;
-				webServerCGIConfig[location] = serverConfig;
-			}
+				phaseStart = std::chrono::steady_clock::now();
+				std::shared_ptr<webServer> server = std::make_shared<webServer>(
+					parser[j]._parsingServer, parser[j]._parsingLocation, worker, workerCount);
+				socketTime += millisecondsSince(phaseStart);
 
-			server->getCGIHandler().setCGIConfig(webServerCGIConfig);
+				server->setRouter(router);
+				server->setServerNames(parser[j].getServerNames());
+				server->setErrorPages(parser[j].getErrorPages());
 
-			for (const auto& [serverBlock, serverName] : parser[j].getServerNames())
-			{
-				size_t maxBodySize = parser[j].getClientMaxBodySize(serverBlock);
-				server->setClientMaxBodySize(serverName, maxBodySize);
-			}
+				for (const auto& [serverBlock, serverName] : parser[j].getServerNames())
+				{
+					size_t maxBodySize = parser[j].getClientMaxBodySize(serverBlock);
+					server->setClientMaxBodySize(serverName, maxBodySize);
+				}
 
-			threads.push_back(std::thread([server]()
-			{
-				server->start();
-			}));
+				phaseStart = std::chrono::steady_clock::now();
+				server->warmCaches();
+				cacheTime += millisecondsSince(phaseStart);
+
+				threads.push_back(std::thread([server]()
+				{
+					server->start();
+				}));
+			}
 		}
 		catch (const std::exception& e)
 		{
-			std::cerr << RED("[ERROR] starting server: " << e.what()) << '\n';
+			LOG_ERROR("Error starting server: " << e.what());
 		}
 	}
 
+	LOG_INFO("Startup took " << std::fixed << std::setprecision(1) << millisecondsSince(startupBegin) << " ms (config parse "
+		<< parseTime << " ms, socket setup " << socketTime << " ms, cache warm " << cacheTime << " ms)");
+
 	for (auto &t : threads)
 	{
 		if (t.joinable())
@@ -101,6 +186,7 @@ int main(int argc, char** argv)
 
 /**
  * Evaluation commands:
+ * make bench (or make bench BENCH_ARGS="--keepalive off --connections 128")
  * brew install siege
  * siege -b -t30s http://127.0.0.1:8082/
  * brew install watch
@@ -0,0 +1,771 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/19 09:47:15 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/19 09:47:15 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * Closed-loop HTTP load generator for webServ (Linux, epoll).
+ * Starts ./webServ on a generated config, keeps a fixed number of connections busy,
+ * each with up to --pipeline requests in flight, and reports throughput, latency
+ * percentiles and the server's CPU time and memory. Results are written as JSON
+ * so runs can be compared across commits. `make bench` builds and runs it.
+ */
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	enum Kind
+	{
+		STATIC,
+		NOT_FOUND,
+		UPLOAD,
+		CGI,
+		KIND_COUNT
+	};
+	const char* const kindNames[] = {"static", "not_found", "upload", "cgi"};
+	const int expectedStatus[] = {200, 404, 201, 200};
+
+	struct Options
+	{
+		double duration = 10;
+		double warmup = 1;
+		int connections = 32;
+		int pipeline = 1;
+		bool keepAlive = true;
+		unsigned mix[KIND_COUNT] = {80, 10, 10, 0};
+		size_t uploadSize = 1024;
+		std::string server = "./webServ";
+		std::string workers = "auto";
+		int attachPort = 0;
+		std::string out;
+		std::string label;
+		unsigned seed = 1;
+	};
+
+	struct InFlight
+	{
+		Kind kind;
+		Clock::time_point sent;
+	};
+
+	struct Client
+	{
+		int fd = -1;
+		std::string out;
+		size_t outOffset = 0;
+		bool wantWrite = false;
+		std::string in;
+		std::deque<InFlight> inflight;
+	};
+
+	struct Results
+	{
+		std::vector<uint64_t> latencies[KIND_COUNT]; // nanoseconds
+		uint64_t unexpected[KIND_COUNT] = {};
+		std::map<int, uint64_t> statuses;
+		uint64_t errors = 0;   // requests lost to a failed or reset connection
+		uint64_t dropped = 0;  // pipelined requests behind a response that closed the connection
+		uint64_t connects = 0;
+	};
+
+	struct ProcessSample
+	{
+		double user = 0;
+		double system = 0;
+		long rssKb = 0;
+		long peakRssKb = 0;
+	};
+
+	void usage(const char* name)
+	{
+		std::cerr << "Usage: " << name << " [options]\n"
+			<< "  --duration S        measured seconds (10)\n"
+			<< "  --warmup S          unmeasured seconds before that (1)\n"
+			<< "  --connections N     concurrent connections (32)\n"
+			<< "  --pipeline N        requests in flight per connection (1)\n"
+			<< "  --keepalive on|off  reuse connections or open one per request (on)\n"
+			<< "  --mix LIST          weights, e.g. static=70,404=10,upload=10,cgi=10 (static=80,404=10,upload=10)\n"
+			<< "  --upload-size BYTES body of each upload (1024)\n"
+			<< "  --workers N|auto    worker_threads of the spawned server (auto)\n"
+			<< "  --server PATH       server binary (./webServ)\n"
+			<< "  --attach PORT       load a server that is already running instead\n"
+			<< "  --out FILE          write the JSON results to FILE\n"
+			<< "  --label TEXT        stored in the results, e.g. the commit\n"
+			<< "  --seed N            request mix seed (1)\n";
+	}
+
+	Options parseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string name = argv[i];
+			if (i + 1 >= argc)
+				throw std::runtime_error("Missing value for " + name);
+			std::string value = argv[++i];
+			if (name == "--duration")
+				options.duration = std::stod(value);
+			else if (name == "--warmup")
+				options.warmup = std::stod(value);
+			else if (name == "--connections")
+				options.connections = std::stoi(value);
+			else if (name == "--pipeline")
+				options.pipeline = std::stoi(value);
+			else if (name == "--keepalive")
+				options.keepAlive = (value == "on");
+			else if (name == "--upload-size")
+				options.uploadSize = std::stoul(value);
+			else if (name == "--workers")
+				options.workers = value;
+			else if (name == "--server")
+				options.server = value;
+			else if (name == "--attach")
+				options.attachPort = std::stoi(value);
+			else if (name == "--out")
+				options.out = value;
+			else if (name == "--label")
+				options.label = value;
+			else if (name == "--seed")
+				options.seed = std::stoul(value);
+			else if (name == "--mix")
+			{
+				std::fill(std::begin(options.mix), std::end(options.mix), 0);
+				std::istringstream list(value);
+				std::string item;
+				while (std::getline(list, item, ','))
+				{
+					size_t equals = item.find('=');
+					std::string kind = item.substr(0, equals);
+					unsigned weight = (equals == std::string::npos) ? 1 : std::stoul(item.substr(equals + 1));
+					if (kind == "static")
+						options.mix[STATIC] = weight;
+					else if (kind == "404" || kind == "not_found")
+						options.mix[NOT_FOUND] = weight;
+					else if (kind == "upload")
+						options.mix[UPLOAD] = weight;
+					else if (kind == "cgi")
+						options.mix[CGI] = weight;
+					else
+						throw std::runtime_error("Unknown request kind in --mix: " + kind);
+				}
+			}
+			else
+				throw std::runtime_error("Unknown option " + name);
+		}
+		if (options.connections < 1 || options.pipeline < 1 || options.duration <= 0)
+			throw std::runtime_error("connections, pipeline and duration must be positive");
+		if (std::all_of(std::begin(options.mix), std::end(options.mix), [](unsigned w) { return w == 0; }))
+			throw std::runtime_error("--mix selects no requests");
+		if (!options.keepAlive)
+			options.pipeline = 1;
+		return options;
+	}
+
+	std::string buildRequest(Kind kind, const Options& options)
+	{
+		std::string connection = options.keepAlive ? "" : "Connection: close\r\n";
+		switch (kind)
+		{
+			case STATIC:
+				return "GET / HTTP/1.1\r\nHost: localhost\r\n" + connection + "\r\n";
+			case NOT_FOUND:
+				return "GET /bench-not-found HTTP/1.1\r\nHost: localhost\r\n" + connection + "\r\n";
+			case UPLOAD:
+				return "POST / HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\nContent-Length: "
+					+ std::to_string(options.uploadSize) + "\r\n" + connection + "\r\n" + std::string(options.uploadSize, 'x');
+			default:
+				return "GET /cgi-bin/script.py HTTP/1.1\r\nHost: localhost\r\n" + connection + "\r\n";
+		}
+	}
+
+	int freePort()
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length = sizeof(address);
+		if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0
+			|| getsockname(fd, reinterpret_cast<struct sockaddr*>(&address), &length) < 0)
+			throw std::runtime_error(std::string("Cannot find a free port: ") + strerror(errno));
+		close(fd);
+		return ntohs(address.sin_port);
+	}
+
+	std::string writeConfig(const std::string& directory, int port, const Options& options)
+	{
+		std::string path = directory + "/bench.config";
+		std::ofstream config(path);
+		config << "http {\n"
+			<< "\tserver {\n"
+			<< "\t\tlisten " << port << ";\n"
+			<< "\t\tserver_name localhost;\n"
+			<< "\t\tclient_max_body_size 10M;\n"
+			<< "\t\tworker_threads " << options.workers << ";\n"
+			<< "\t\tkeepalive_requests 1000000000;\n"
+			<< "\t\tlog_level warn;\n"
+			<< "\t\troot ./www/html;\n"
+			<< "\t\tindex index.html;\n"
+			<< "\t\tupload_dir " << directory << "/upload;\n"
+			<< "\t\terror_pages 404 /error_404.html;\n"
+			<< "\t\tlocation / {\n"
+			<< "\t\tmethods GET POST DELETE;\n"
+			<< "\t\t}\n"
+			<< "\t\tlocation /cgi-bin/ {\n"
+			<< "\t\t\tcgi_pass /usr/bin/python3;\n"
+			<< "\t\t\tcgi_param SCRIPT_FILENAME /cgi-bin/script.py;\n"
+			<< "\t\t\tcgi_param PATH_INFO $fastcgi_script_name;\n"
+			<< "\t\t\tcgi_param QUERY_STRING $query_string;\n"
+			<< "\t\t\tcgi_param REQUEST_METHOD $request_method;\n"
+			<< "\t\t}\n"
+			<< "\t}\n"
+			<< "}\n";
+		if (!config)
+			throw std::runtime_error("Cannot write " + path);
+		return path;
+	}
+
+	pid_t startServer(const Options& options, const std::string& configPath, const std::string& logPath)
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+			throw std::runtime_error(std::string("fork failed: ") + strerror(errno));
+		if (pid == 0)
+		{
+			int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (log >= 0)
+			{
+				dup2(log, STDOUT_FILENO);
+				dup2(log, STDERR_FILENO);
+			}
+			execl(options.server.c_str(), options.server.c_str(), configPath.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+		return pid;
+	}
+
+	bool canConnect(int port)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bool connected = fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+		if (fd >= 0)
+			close(fd);
+		return connected;
+	}
+
+	bool waitForServer(int port, pid_t pid)
+	{
+		for (int attempt = 0; attempt < 500; attempt++)
+		{
+			if (canConnect(port))
+				return true;
+			if (pid > 0 && waitpid(pid, nullptr, WNOHANG) == pid)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		return false;
+	}
+
+	// utime and stime from /proc/PID/stat (all threads), VmRSS and VmHWM from /proc/PID/status
+	ProcessSample sampleProcess(pid_t pid)
+	{
+		ProcessSample sample;
+		if (pid <= 0)
+			return sample;
+
+		std::ifstream statFile("/proc/" + std::to_string(pid) + "/stat");
+		std::string stat((std::istreambuf_iterator<char>(statFile)), std::istreambuf_iterator<char>());
+		size_t commandEnd = stat.rfind(')');
+		if (commandEnd != std::string::npos)
+		{
+			std::istringstream fields(stat.substr(commandEnd + 2));
+			std::string field;
+			double ticks = static_cast<double>(sysconf(_SC_CLK_TCK));
+			for (int index = 3; fields >> field && index <= 15; index++)
+			{
+				if (index == 14)
+					sample.user = std::stod(field) / ticks;
+				else if (index == 15)
+					sample.system = std::stod(field) / ticks;
+			}
+		}
+
+		std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmRSS:") == 0)
+				sample.rssKb = std::stol(line.substr(6));
+			else if (line.compare(0, 6, "VmHWM:") == 0)
+				sample.peakRssKb = std::stol(line.substr(6));
+		}
+		return sample;
+	}
+
+	/**
+	 * Length of the first complete response in the buffer, 0 while it is incomplete.
+	 * A response without Content-Length ends when the server closes the connection.
+	 */
+	size_t parseResponse(const std::string& in, bool eof, int& status, bool& closes)
+	{
+		size_t headEnd = in.find("\r\n\r\n");
+		if (headEnd == std::string::npos)
+			return 0;
+		status = (in.compare(0, 5, "HTTP/") == 0 && in.size() > 12) ? std::atoi(in.c_str() + 9) : 0;
+
+		long contentLength = -1;
+		size_t lineStart = in.find("\r\n") + 2;
+		while (lineStart < headEnd)
+		{
+			size_t lineEnd = in.find("\r\n", lineStart);
+			std::string line = in.substr(lineStart, lineEnd - lineStart);
+			std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+			if (line.compare(0, 15, "content-length:") == 0)
+				contentLength = std::atol(line.c_str() + 15);
+			else if (line.compare(0, 11, "connection:") == 0 && line.find("close") != std::string::npos)
+				closes = true;
+			lineStart = lineEnd + 2;
+		}
+
+		size_t bodyStart = headEnd + 4;
+		if (contentLength >= 0)
+			return in.size() >= bodyStart + contentLength ? bodyStart + contentLength : 0;
+		if (status == 204 || status == 304 || (status >= 100 && status < 200))
+			return bodyStart;
+		closes = true;
+		return eof ? in.size() : 0;
+	}
+
+	class LoadGenerator {
+		public:
+			LoadGenerator(const Options& options, int port)
+				: _options(options), _port(port), _random(options.seed),
+				_pick(std::begin(options.mix), std::end(options.mix)), _clients(options.connections)
+			{
+				for (int kind = 0; kind < KIND_COUNT; kind++)
+					_requests[kind] = buildRequest(static_cast<Kind>(kind), options);
+				_epoll = epoll_create1(EPOLL_CLOEXEC);
+				if (_epoll < 0)
+					throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+			}
+
+			~LoadGenerator()
+			{
+				for (Client& client : _clients)
+				{
+					if (client.fd >= 0)
+						close(client.fd);
+				}
+				close(_epoll);
+			}
+
+			void run(Clock::time_point measureBegin, Clock::time_point measureEnd)
+			{
+				_measureBegin = measureBegin;
+				_measureEnd = measureEnd;
+				for (size_t i = 0; i < _clients.size(); i++)
+					connectClient(i);
+
+				struct epoll_event events[256];
+				while (Clock::now() < _measureEnd)
+				{
+					int ready = epoll_wait(_epoll, events, 256, 50);
+					for (int i = 0; i < ready; i++)
+					{
+						size_t index = events[i].data.u32;
+						if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+							readResponses(index);
+						else if (events[i].events & EPOLLOUT)
+							sendRequests(index);
+					}
+				}
+			}
+
+			Results& results() { return _results; }
+
+		private:
+			void connectClient(size_t index)
+			{
+				Client& client = _clients[index];
+				client = Client();
+				client.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+				int one = 1;
+				setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+				struct sockaddr_in address = {};
+				address.sin_family = AF_INET;
+				address.sin_port = htons(_port);
+				address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				if (connect(client.fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS)
+				{
+					close(client.fd);
+					client.fd = -1;
+					_results.errors++;
+					return;
+				}
+				_results.connects++;
+
+				struct epoll_event event = {};
+				event.events = EPOLLIN | EPOLLOUT;
+				event.data.u32 = static_cast<uint32_t>(index);
+				epoll_ctl(_epoll, EPOLL_CTL_ADD, client.fd, &event);
+				client.wantWrite = true;
+				queueRequests(client);
+			}
+
+			void queueRequests(Client& client)
+			{
+				auto now = Clock::now();
+				while (client.inflight.size() < static_cast<size_t>(_options.pipeline))
+				{
+					Kind kind = static_cast<Kind>(_pick(_random));
+					client.out += _requests[kind];
+					client.inflight.push_back({kind, now});
+				}
+			}
+
+			void setWriteInterest(size_t index, bool wantWrite)
+			{
+				Client& client = _clients[index];
+				if (client.wantWrite == wantWrite)
+					return;
+				struct epoll_event event = {};
+				event.events = wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+				event.data.u32 = static_cast<uint32_t>(index);
+				epoll_ctl(_epoll, EPOLL_CTL_MOD, client.fd, &event);
+				client.wantWrite = wantWrite;
+			}
+
+			void sendRequests(size_t index)
+			{
+				Client& client = _clients[index];
+				while (client.outOffset < client.out.size())
+				{
+					ssize_t sent = send(client.fd, client.out.data() + client.outOffset,
+						client.out.size() - client.outOffset, MSG_NOSIGNAL);
+					if (sent < 0)
+					{
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+						{
+							setWriteInterest(index, true);
+							return;
+						}
+						reconnect(index, false);
+						return;
+					}
+					client.outOffset += static_cast<size_t>(sent);
+				}
+				client.out.clear();
+				client.outOffset = 0;
+				setWriteInterest(index, false);
+			}
+
+			void readResponses(size_t index)
+			{
+				Client& client = _clients[index];
+				char buffer[64 * 1024];
+				bool eof = false;
+				while (true)
+				{
+					ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+					if (received > 0)
+					{
+						client.in.append(buffer, received);
+						continue;
+					}
+					if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+						eof = true;
+					break;
+				}
+
+				bool closes = false;
+				while (!client.inflight.empty() && !closes)
+				{
+					int status = 0;
+					size_t length = parseResponse(client.in, eof, status, closes);
+					if (length == 0)
+						break;
+					complete(client.inflight.front(), status);
+					client.inflight.pop_front();
+					client.in.erase(0, length);
+				}
+
+				if (closes || eof)
+				{
+					reconnect(index, closes);
+					return;
+				}
+				if (client.inflight.empty())
+				{
+					queueRequests(client);
+					sendRequests(index);
+				}
+			}
+
+			// A response that announced the close loses only the requests pipelined behind it
+			void reconnect(size_t index, bool announced)
+			{
+				Client& client = _clients[index];
+				(announced ? _results.dropped : _results.errors) += client.inflight.size();
+				close(client.fd);
+				client.fd = -1;
+				connectClient(index);
+			}
+
+			void complete(const InFlight& request, int status)
+			{
+				auto now = Clock::now();
+				if (request.sent < _measureBegin || now > _measureEnd)
+					return;
+				_results.latencies[request.kind].push_back(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(now - request.sent).count());
+				_results.statuses[status]++;
+				if (status != expectedStatus[request.kind])
+					_results.unexpected[request.kind]++;
+			}
+
+			const Options& _options;
+			int _port;
+			std::mt19937 _random;
+			std::discrete_distribution<int> _pick;
+			std::string _requests[KIND_COUNT];
+			std::vector<Client> _clients;
+			int _epoll;
+			Clock::time_point _measureBegin;
+			Clock::time_point _measureEnd;
+			Results _results;
+	};
+
+	double percentile(const std::vector<uint64_t>& sorted, double q)
+	{
+		if (sorted.empty())
+			return 0;
+		size_t rank = static_cast<size_t>(q * sorted.size());
+		return sorted[std::min(rank, sorted.size() - 1)] / 1e3;
+	}
+
+	void writeLatency(std::ostream& out, const std::vector<uint64_t>& sorted)
+	{
+		double sum = 0;
+		for (uint64_t value : sorted)
+			sum += value;
+		out << "{\"count\":" << sorted.size()
+			<< ",\"mean_us\":" << (sorted.empty() ? 0 : sum / sorted.size() / 1e3)
+			<< ",\"p50_us\":" << percentile(sorted, 0.5)
+			<< ",\"p99_us\":" << percentile(sorted, 0.99)
+			<< ",\"p999_us\":" << percentile(sorted, 0.999)
+			<< ",\"max_us\":" << (sorted.empty() ? 0 : sorted.back() / 1e3) << "}";
+	}
+
+	std::string toJson(const Options& options, Results& results, const ProcessSample& before,
+		const ProcessSample& after, bool haveServer)
+	{
+		std::vector<uint64_t> all;
+		for (std::vector<uint64_t>& latencies : results.latencies)
+		{
+			std::sort(latencies.begin(), latencies.end());
+			all.insert(all.end(), latencies.begin(), latencies.end());
+		}
+		std::sort(all.begin(), all.end());
+
+		uint64_t unexpected = 0;
+		for (uint64_t count : results.unexpected)
+			unexpected += count;
+
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(3);
+		out << "{\"label\":\"" << options.label << "\""
+			<< ",\"config\":{\"duration_s\":" << options.duration << ",\"warmup_s\":" << options.warmup
+			<< ",\"connections\":" << options.connections << ",\"pipeline\":" << options.pipeline
+			<< ",\"keepalive\":" << (options.keepAlive ? "true" : "false")
+			<< ",\"workers\":\"" << options.workers << "\",\"upload_size\":" << options.uploadSize << ",\"mix\":{";
+		for (int kind = 0; kind < KIND_COUNT; kind++)
+			out << (kind ? "," : "") << "\"" << kindNames[kind] << "\":" << options.mix[kind];
+		out << "}}"
+			<< ",\"requests\":" << all.size()
+			<< ",\"throughput_rps\":" << all.size() / options.duration
+			<< ",\"errors\":" << results.errors
+			<< ",\"dropped\":" << results.dropped
+			<< ",\"unexpected_status\":" << unexpected
+			<< ",\"connections_opened\":" << results.connects
+			<< ",\"latency\":";
+		writeLatency(out, all);
+		out << ",\"by_kind\":{";
+		bool first = true;
+		for (int kind = 0; kind < KIND_COUNT; kind++)
+		{
+			if (options.mix[kind] == 0)
+				continue;
+			out << (first ? "" : ",") << "\"" << kindNames[kind] << "\":";
+			writeLatency(out, results.latencies[kind]);
+			first = false;
+		}
+		out << "},\"status\":{";
+		first = true;
+		for (const auto& [status, count] : results.statuses)
+		{
+			out << (first ? "" : ",") << "\"" << status << "\":" << count;
+			first = false;
+		}
+		out << "}";
+		if (haveServer)
+		{
+			double cpu = (after.user - before.user) + (after.system - before.system);
+			out << ",\"server\":{\"cpu_user_s\":" << after.user - before.user
+				<< ",\"cpu_system_s\":" << after.system - before.system
+				<< ",\"cpu_percent\":" << 100 * cpu / options.duration
+				<< ",\"rss_kb\":" << after.rssKb << ",\"peak_rss_kb\":" << after.peakRssKb << "}";
+		}
+		out << "}\n";
+		return out.str();
+	}
+
+	void printSummary(const Options& options, Results& results, const ProcessSample& before,
+		const ProcessSample& after, bool haveServer)
+	{
+		std::vector<uint64_t> all;
+		for (const std::vector<uint64_t>& latencies : results.latencies)
+			all.insert(all.end(), latencies.begin(), latencies.end());
+		std::sort(all.begin(), all.end());
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "webServ-bench: " << options.connections << " connections, pipeline " << options.pipeline
+			<< ", keep-alive " << (options.keepAlive ? "on" : "off") << ", " << options.duration << " s\n"
+			<< "  throughput  " << all.size() / options.duration << " req/s (" << all.size() << " requests, "
+			<< results.errors << " errors)\n" << std::setprecision(3)
+			<< "  latency     p50 " << percentile(all, 0.5) / 1e3 << " ms, p99 " << percentile(all, 0.99) / 1e3
+			<< " ms, p99.9 " << percentile(all, 0.999) / 1e3 << " ms\n";
+		for (int kind = 0; kind < KIND_COUNT; kind++)
+		{
+			if (options.mix[kind] == 0)
+				continue;
+			std::cout << "  " << std::left << std::setw(12) << kindNames[kind] << std::right
+				<< results.latencies[kind].size() << " requests, p99 " << percentile(results.latencies[kind], 0.99) / 1e3
+				<< " ms, " << results.unexpected[kind] << " unexpected status\n";
+		}
+		if (haveServer)
+		{
+			double cpu = (after.user - before.user) + (after.system - before.system);
+			std::cout << std::setprecision(1) << "  server      cpu " << 100 * cpu / options.duration << "%, rss "
+				<< after.rssKb / 1024.0 << " MB (peak " << after.peakRssKb / 1024.0 << " MB)\n";
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (argc > 1 && (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h"))
+	{
+		usage(argv[0]);
+		return 0;
+	}
+	try {
+		options = parseOptions(argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		usage(argv[0]);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	std::string directory;
+	pid_t server = -1;
+	int port = options.attachPort;
+	int status = 0;
+	try {
+		if (port == 0)
+		{
+			char pattern[] = "/tmp/webserv-bench-XXXXXX";
+			if (!mkdtemp(pattern))
+				throw std::runtime_error(std::string("mkdtemp failed: ") + strerror(errno));
+			directory = pattern;
+			port = freePort();
+			server = startServer(options, writeConfig(directory, port, options), directory + "/server.log");
+		}
+		if (!waitForServer(port, server))
+			throw std::runtime_error("Server did not start listening on port " + std::to_string(port)
+				+ (directory.empty() ? "" : ", see " + directory + "/server.log"));
+
+		LoadGenerator generator(options, port);
+		auto begin = Clock::now();
+		auto measureBegin = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+		auto measureEnd = measureBegin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+
+		// Sampled from a helper thread so the samples line up with the measured window
+		ProcessSample before;
+		std::thread sampler([&]() {
+			std::this_thread::sleep_until(measureBegin);
+			before = sampleProcess(server);
+		});
+		generator.run(measureBegin, measureEnd);
+		sampler.join();
+		ProcessSample after = sampleProcess(server);
+
+		std::string json = toJson(options, generator.results(), before, after, server > 0);
+		printSummary(options, generator.results(), before, after, server > 0);
+		if (!options.out.empty())
+		{
+			std::ofstream(options.out) << json;
+			std::cout << "  results     " << options.out << "\n";
+		}
+		else
+		{
+			std::cout << json;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "webServ-bench: " << e.what() << std::endl;
+		status = 1;
+	}
+
+	if (server > 0)
+	{
+		kill(server, SIGTERM);
+		waitpid(server, nullptr, 0);
+	}
+	if (!directory.empty() && status == 0)
+		std::filesystem::remove_all(directory);
+	return status;
+}
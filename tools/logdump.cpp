@@ -0,0 +1,176 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   logdump.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/17 14:02:51 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/17 14:02:51 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "AccessLogFormat.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <utility>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <ctime>
+#include <arpa/inet.h>
+
+/**
+ * Decodes the binary access log written by webServ, one line per request.
+ * Usage: webServ-logdump [--csv] FILE...
+ * Files are decoded in order, so rotated logs are passed oldest first.
+ */
+
+using namespace accesslog;
+
+typedef std::map<std::pair<uint16_t, uint32_t>, std::string> StringTable;
+
+static std::string formatTime(uint64_t microseconds)
+{
+	time_t seconds = static_cast<time_t>(microseconds / 1000000);
+	struct tm utc;
+	gmtime_r(&seconds, &utc);
+	char buffer[32];
+	strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+	std::ostringstream out;
+	out << buffer << '.' << std::setw(6) << std::setfill('0') << microseconds % 1000000 << 'Z';
+	return out.str();
+}
+
+static std::string formatAddress(const RequestRecord& record)
+{
+	char buffer[INET6_ADDRSTRLEN] = "-";
+	if (record.addressFamily == 4)
+		inet_ntop(AF_INET, record.address, buffer, sizeof(buffer));
+	else if (record.addressFamily == 6)
+		inet_ntop(AF_INET6, record.address, buffer, sizeof(buffer));
+	return buffer;
+}
+
+static std::string lookup(const StringTable& strings, uint16_t writer, uint32_t id)
+{
+	auto it = strings.find({writer, id});
+	if (it == strings.end() || it->second.empty())
+		return "-";
+	return it->second;
+}
+
+static std::string csvQuote(const std::string& field)
+{
+	std::string quoted = "\"";
+	for (char c : field)
+	{
+		if (c == '"')
+			quoted += '"';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+static void printRecord(const RequestRecord& record, const StringTable& strings, bool csv)
+{
+	std::string vhost = lookup(strings, record.writer, record.vhost);
+	std::string path = lookup(strings, record.writer, record.path);
+	if (csv)
+	{
+		std::cout << formatTime(record.timestamp) << ',' << formatAddress(record) << ',' << record.port << ','
+			<< csvQuote(vhost) << ',' << methodName(record.method) << ',' << csvQuote(path) << ','
+			<< record.status << ',' << record.bytesIn << ',' << record.bytesOut << ',' << record.duration << '\n';
+		return;
+	}
+	std::cout << formatTime(record.timestamp) << ' ' << formatAddress(record) << ':' << record.port << ' '
+		<< vhost << " \"" << methodName(record.method) << ' ' << path << "\" " << record.status << ' '
+		<< record.bytesIn << ' ' << record.bytesOut << ' ' << std::fixed << std::setprecision(3)
+		<< record.duration / 1000.0 << " ms\n";
+}
+
+static bool dumpFile(const char* filename, bool csv)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << filename << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	FileHeader header;
+	if (data.size() < sizeof(header) || std::memcmp(data.data(), magic, sizeof(magic)) != 0)
+	{
+		std::cerr << filename << ": not a webServ access log" << std::endl;
+		return false;
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.version != version || header.recordSize != sizeof(RequestRecord))
+	{
+		std::cerr << filename << ": unsupported access log version " << header.version << std::endl;
+		return false;
+	}
+
+	StringTable strings;
+	size_t offset = sizeof(header);
+	while (offset + sizeof(uint16_t) <= data.size())
+	{
+		uint16_t type;
+		std::memcpy(&type, data.data() + offset, sizeof(type));
+		if (type == REQUEST && offset + sizeof(RequestRecord) <= data.size())
+		{
+			RequestRecord record;
+			std::memcpy(&record, data.data() + offset, sizeof(record));
+			printRecord(record, strings, csv);
+			offset += sizeof(record);
+		}
+		else if (type == STRING && offset + sizeof(StringRecord) <= data.size())
+		{
+			StringRecord record;
+			std::memcpy(&record, data.data() + offset, sizeof(record));
+			offset += sizeof(record);
+			if (offset + padded(record.length) > data.size())
+				break;
+			strings[{record.writer, record.id}] = data.substr(offset, record.length);
+			offset += padded(record.length);
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (offset != data.size())
+	{
+		std::cerr << filename << ": truncated or corrupt entry at byte " << offset << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool csv = false;
+	int first = 1;
+	if (argc > 1 && std::string(argv[1]) == "--csv")
+	{
+		csv = true;
+		first = 2;
+	}
+	if (first >= argc)
+	{
+		std::cerr << "Usage: " << argv[0] << " [--csv] FILE..." << std::endl;
+		return 1;
+	}
+
+	if (csv)
+		std::cout << "timestamp,client,port,vhost,method,path,status,bytes_in,bytes_out,duration_us\n";
+	bool ok = true;
+	for (int i = first; i < argc; i++)
+		ok = dumpFile(argv[i], csv) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,506 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   microbench.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: anamieta <anamieta@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/19 16:12:40 by pwojnaro          #+#    #+#             */
+/*   Updated: 2025/04/19 16:12:40 by pwojnaro         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "WebServer.hpp"
+#include "HTTPRequest.hpp"
+#include "HTTPResponse.hpp"
+#include "Scan.hpp"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Microbenchmarks for the pure functions on the request path, linked against the
+ * server objects as they are built. Every benchmark is calibrated to run for at least
+ * --min-time per sample, then sampled --samples times; the median ns/op is reported
+ * with its median absolute deviation. Allocations are counted by replacing the global
+ * operator new, so allocs/op and bytes/op are exact for the benchmark thread.
+ * Before timing anything, every SIMD kernel set of scan:: is checked against the scalar one.
+ */
+
+namespace
+{
+	thread_local uint64_t allocationCount = 0;
+	thread_local uint64_t allocationBytes = 0;
+
+	void* countedAllocation(std::size_t size) noexcept
+	{
+		allocationCount++;
+		allocationBytes += size;
+		return std::malloc(size ? size : 1);
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* memory = countedAllocation(size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Keeps a result alive so the call producing it cannot be dropped
+	template <typename T>
+	void keep(const T& value)
+	{
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	struct Options
+	{
+		int samples = 10;
+		double minTimeMs = 20;
+		size_t multipartMb = 100;
+		std::string filter;
+	};
+
+	class Runner {
+		public:
+			explicit Runner(const Options& options) : _options(options)
+			{
+				std::cout << std::left << std::setw(34) << "benchmark" << std::right
+					<< std::setw(12) << "ns/op" << std::setw(8) << "+/-%"
+					<< std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op"
+					<< std::setw(12) << "input" << std::setw(10) << "MB/s" << "\n";
+			}
+
+			// inputBytes is the size of the corpus one operation consumes, 0 when that is meaningless
+			void run(const std::string& name, size_t inputBytes, const std::function<void()>& operation)
+			{
+				if (!_options.filter.empty() && name.find(_options.filter) == std::string::npos)
+					return;
+
+				operation(); // warm caches and lazily built tables
+				uint64_t iterations = 1;
+				while (true)
+				{
+					double elapsed = timeBatch(operation, iterations);
+					if (elapsed >= _options.minTimeMs * 1e6 || iterations >= (1ULL << 30))
+						break;
+					double scale = elapsed > 0 ? _options.minTimeMs * 1e6 / elapsed : 100;
+					iterations = static_cast<uint64_t>(iterations * std::clamp(scale * 1.2, 2.0, 100.0));
+				}
+
+				std::vector<double> perOp;
+				uint64_t allocations = 0;
+				uint64_t bytes = 0;
+				for (int sample = 0; sample < _options.samples; sample++)
+				{
+					uint64_t countBefore = allocationCount;
+					uint64_t bytesBefore = allocationBytes;
+					perOp.push_back(timeBatch(operation, iterations) / iterations);
+					allocations += allocationCount - countBefore;
+					bytes += allocationBytes - bytesBefore;
+				}
+
+				double median = medianOf(perOp);
+				std::vector<double> deviations;
+				for (double value : perOp)
+					deviations.push_back(std::abs(value - median));
+				double spread = median > 0 ? 100 * medianOf(deviations) / median : 0;
+				double operations = static_cast<double>(iterations) * _options.samples;
+
+				std::cout << std::left << std::setw(34) << name << std::right << std::fixed
+					<< std::setprecision(1) << std::setw(12) << median << std::setw(8) << spread
+					<< std::setw(12) << allocations / operations << std::setw(12) << std::setprecision(0) << bytes / operations
+					<< std::setw(12) << inputBytes;
+				if (inputBytes)
+					std::cout << std::setw(10) << std::setprecision(1) << inputBytes * 1e3 / median;
+				std::cout << std::endl;
+			}
+
+		private:
+			static double timeBatch(const std::function<void()>& operation, uint64_t iterations)
+			{
+				auto begin = Clock::now();
+				for (uint64_t i = 0; i < iterations; i++)
+					operation();
+				return std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+			}
+
+			static double medianOf(std::vector<double> values)
+			{
+				std::sort(values.begin(), values.end());
+				size_t middle = values.size() / 2;
+				return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+			}
+
+			const Options& _options;
+	};
+
+	// Headers of a Chrome navigation with the usual client hints and cookies
+	const std::string browserHeaders =
+		"Host: shop.example.com\r\n"
+		"Connection: keep-alive\r\n"
+		"sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+		"sec-ch-ua-mobile: ?0\r\n"
+		"sec-ch-ua-platform: \"macOS\"\r\n"
+		"Upgrade-Insecure-Requests: 1\r\n"
+		"User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+		"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+		"Sec-Fetch-Site: same-origin\r\n"
+		"Sec-Fetch-Mode: navigate\r\n"
+		"Sec-Fetch-User: ?1\r\n"
+		"Sec-Fetch-Dest: document\r\n"
+		"Referer: https://shop.example.com/products/shoes?size=42\r\n"
+		"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+		"Accept-Language: en-US,en;q=0.9,pl;q=0.8,de;q=0.7\r\n"
+		"Cookie: session=7f3c2a91e4b84d0fa1c6e2d59b7a3f08; _ga=GA1.1.1234567890.1713523200; "
+		"_ga_XYZ=GS1.1.1713523200.3.1.1713524000.0.0.0; cart=3%7C17%7C42; theme=dark; consent=analytics%3Dyes%26ads%3Dno\r\n"
+		"\r\n";
+
+	std::string longQuery()
+	{
+		std::string query = "/search?q=";
+		for (int i = 0; i < 40; i++)
+			query += "caf%C3%A9+au+lait+%26+croissant+" + std::to_string(i) + "&filter%5B" + std::to_string(i) + "%5D=price%3E10%2Cprice%3C100&";
+		return query + "page=2";
+	}
+
+	std::string deepPath()
+	{
+		std::string path;
+		for (int i = 0; i < 64; i++)
+		{
+			path += "/level" + std::to_string(i);
+			if (i % 8 == 3)
+				path += "/./";
+			if (i % 16 == 7)
+				path += "/tmp/..";
+		}
+		return path + "/index.html";
+	}
+
+	// A config with count locations: api versions, per-tenant static roots and redirects
+	std::map<std::string, LocationDirectives> manyLocations(size_t count)
+	{
+		std::map<std::string, LocationDirectives> locations;
+		locations["/"].methods = LocationConfig::GET | LocationConfig::POST | LocationConfig::DELETE;
+		for (size_t i = 0; locations.size() < count; i++)
+		{
+			std::string tenant = "/tenant" + std::to_string(i);
+			locations[tenant].root = "./www/tenants/" + std::to_string(i);
+			locations[tenant + "/api/v" + std::to_string(i % 3 + 1)].methods = LocationConfig::GET | LocationConfig::POST;
+			locations[tenant + "/assets"].autoindex = true;
+			locations["/old" + std::to_string(i)].redirect = "301 https://example.com/new" + std::to_string(i);
+		}
+		return locations;
+	}
+
+	std::string multipartBody(const std::string& boundary, size_t size)
+	{
+		std::string body = "--" + boundary + "\r\n"
+			"Content-Disposition: form-data; name=\"file\"; filename=\"holiday video (final).mp4\"\r\n"
+			"Content-Type: video/mp4\r\n\r\n";
+		body.reserve(body.size() + size + boundary.size() + 8);
+		uint32_t state = 2463534242u;
+		for (size_t i = 0; i < size; i++)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			body += static_cast<char>(state);
+		}
+		return body + "\r\n--" + boundary + "--\r\n";
+	}
+
+	/**
+	 * Random inputs over a five letter alphabet are dense with partial delimiters and
+	 * near-miss needles, half the needles are cut from the input so they are found.
+	 * Every level the CPU supports must agree with the scalar kernels and with std::string_view.
+	 */
+	bool validateScanning()
+	{
+		std::mt19937 random(42);
+		const char alphabet[] = "\r\n-ab";
+		size_t cases = 0;
+		for (int round = 0; round < 20000; round++)
+		{
+			std::string data(random() % 260, ' ');
+			for (char& c : data)
+				c = alphabet[random() % 5];
+			std::string needle;
+			if (!data.empty() && random() % 2)
+			{
+				size_t start = random() % data.size();
+				needle = data.substr(start, 1 + random() % 48);
+			}
+			else
+			{
+				needle.resize(random() % 48);
+				for (char& c : needle)
+					c = alphabet[random() % 5];
+			}
+			size_t from = random() % (data.size() + 2);
+
+			std::string_view view(data);
+			size_t expected[3] = {view.find("\r\n\r\n", from), view.find("\r\n", from), view.find(needle, from)};
+			for (int level = scan::SCALAR; level <= scan::bestLevel(); level++)
+			{
+				scan::setLevel(static_cast<scan::Level>(level));
+				size_t found[3] = {scan::findHeaderEnd(view, from), scan::findLineEnd(view, from), scan::find(view, needle, from)};
+				for (int check = 0; check < 3; check++)
+				{
+					if (found[check] == expected[check])
+						continue;
+					std::cerr << "scan mismatch: " << scan::levelName(static_cast<scan::Level>(level))
+						<< (check == 0 ? " findHeaderEnd" : check == 1 ? " findLineEnd" : " find")
+						<< " size " << data.size() << " needle " << needle.size() << " from " << from
+						<< " returned " << found[check] << ", expected " << expected[check] << "\n";
+					scan::setLevel(scan::bestLevel());
+					return false;
+				}
+				cases += 3;
+			}
+		}
+		scan::setLevel(scan::bestLevel());
+		std::cout << "scan: " << cases << " checks agree, kernels up to " << scan::levelName(scan::bestLevel()) << "\n\n";
+		return true;
+	}
+
+	void usage(const char* name)
+	{
+		std::cerr << "Usage: " << name << " [--filter TEXT] [--samples N] [--min-time MS] [--multipart-mb N]\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			usage(argv[0]);
+			return option == "--help" || option == "-h" ? 0 : 1;
+		}
+		std::string value = argv[++i];
+		if (option == "--filter")
+			options.filter = value;
+		else if (option == "--samples")
+			options.samples = std::max(1, std::stoi(value));
+		else if (option == "--min-time")
+			options.minTimeMs = std::stod(value);
+		else if (option == "--multipart-mb")
+			options.multipartMb = std::stoul(value);
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!validateScanning())
+		return 1;
+
+	std::filesystem::path uploadDir = std::filesystem::temp_directory_path()
+		/ ("webserv-microbench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(uploadDir);
+	int status = 0;
+	try {
+		// listen 0 binds an ephemeral port, the server is only used for its member functions
+		std::unordered_multimap<std::string, std::string> serverConfig = {
+			{"listen", "0"}, {"server_name", "localhost"}, {"log_level", "warn"}
+		};
+		webServer server(serverConfig, {});
+		std::map<std::string, LocationDirectives> locations;
+		locations["/images"].root = "./www/html/images";
+		locations["/cgi-bin"].root = "./cgi-bin";
+		locations["/level0/level1"].root = "./www/html/deep";
+		locations["/upload"].root = "./www/html/upload";
+		server.setRouter(std::make_shared<const LocationRouter>(locations));
+
+		Runner runner(options);
+
+		const std::string getRequest = "GET /products/search?category=shoes&size=42&color=black HTTP/1.1\r\n" + browserHeaders;
+		runner.run("parseRequest/browser_get", getRequest.size(), [&]() {
+			HTTPRequest request(getRequest);
+			keep(request);
+		});
+		std::string form;
+		for (int i = 0; i < 64; i++)
+			form += "field" + std::to_string(i) + "=value+with+some%20text&";
+		const std::string postRequest = "POST /submit HTTP/1.1\r\n"
+			"Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(form.size()) + "\r\n"
+			+ browserHeaders + form;
+		runner.run("parseRequest/form_post", postRequest.size(), [&]() {
+			HTTPRequest request(postRequest);
+			keep(request);
+		});
+
+		runner.run("parseHeaders/browser", browserHeaders.size(), [&]() {
+			keep(server.parseHeaders(browserHeaders));
+		});
+
+		const std::string query = longQuery();
+		runner.run("urlDecode/long_query", query.size(), [&]() {
+			keep(urlDecode(query));
+		});
+		const std::string plainPath = "/images/summer/2024/beach.jpg";
+		runner.run("urlDecode/plain_path", plainPath.size(), [&]() {
+			keep(urlDecode(plainPath));
+		});
+
+		const std::string deep = deepPath();
+		runner.run("sanitizePath/deep", deep.size(), [&]() {
+			keep(server.sanitizePath(deep));
+		});
+		runner.run("sanitizePath/short", plainPath.size(), [&]() {
+			keep(server.sanitizePath(plainPath));
+		});
+		runner.run("resolveFilePath/deep", deep.size(), [&]() {
+			keep(server.resolveFilePath(deep, "./www/html"));
+		});
+		runner.run("resolveFilePath/location", plainPath.size(), [&]() {
+			keep(server.resolveFilePath(plainPath, "./www/html"));
+		});
+
+		// Routing cost must not grow with the number of locations, the linear scan shows what it replaced
+		const std::string routed = "/tenant0/api/v1/orders/2024/04/invoice.pdf";
+		for (size_t count : {4, 400})
+		{
+			std::map<std::string, LocationDirectives> config = manyLocations(count);
+			LocationRouter router(config);
+			const std::string label = std::to_string(config.size()) + "_locations";
+			runner.run("route/radix/" + label, routed.size(), [&]() {
+				keep(router.match(routed).path);
+			});
+			runner.run("route/linear_scan/" + label, routed.size(), [&]() {
+				const std::string* best = nullptr;
+				for (const auto& [location, directives] : config)
+				{
+					if (routed.compare(0, location.size(), location) == 0 && (!best || location.size() > best->size()))
+						best = &location;
+				}
+				keep(best);
+			});
+		}
+
+		const std::string filename = "Résumé – Piotr (final version) [2024] #3.pdf";
+		runner.run("sanitizeFilename/unicode", filename.size(), [&]() {
+			keep(server.sanitizeFilename(filename));
+		});
+
+		const std::vector<std::string> files = {
+			"/index.html", "/css/site.css", "/js/app.min.js", "/images/photo.jpeg",
+			"/images/logo.png", "/docs/manual.pdf", "/video/intro.mp4", "/download/archive.tar.gz"
+		};
+		size_t next = 0;
+		runner.run("getContentType/mixed", 0, [&]() {
+			keep(HTTPResponse::getContentType(files[next++ % files.size()]));
+		});
+		runner.run("mimeLookup/mixed", 0, [&]() {
+			keep(MimeTypes::instance().lookup(files[next++ % files.size()]).headerLine.size());
+		});
+
+		for (int level = scan::SCALAR; level <= scan::bestLevel(); level++)
+		{
+			scan::setLevel(static_cast<scan::Level>(level));
+			runner.run(std::string("scan/header_end/") + scan::levelName(static_cast<scan::Level>(level)), getRequest.size(), [&]() {
+				keep(scan::findHeaderEnd(getRequest));
+			});
+			runner.run(std::string("scan/lines/") + scan::levelName(static_cast<scan::Level>(level)), browserHeaders.size(), [&]() {
+				std::string_view rest = browserHeaders;
+				while (!rest.empty())
+					keep(scan::nextLine(rest));
+			});
+		}
+		scan::setLevel(scan::bestLevel());
+
+		const HTTPResponse page(200, "text/html", std::string(4096, 'x'));
+		runner.run("generateResponse/4k_html", 4096, [&]() {
+			keep(page.generateResponse());
+		});
+		const HTTPResponse small(404, "text/plain", "Not Found");
+		runner.run("generateResponse/small", 9, [&]() {
+			keep(small.generateResponse());
+		});
+
+		if (options.multipartMb > 0)
+		{
+			const std::string boundary = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+			const std::string contentType = "multipart/form-data; boundary=" + boundary;
+			const std::string body = multipartBody(boundary, options.multipartMb * 1024 * 1024);
+			const std::string delimiter = "\r\n--" + boundary;
+			const std::string label = std::to_string(options.multipartMb) + "mb/";
+			runner.run("scan/boundary/" + label + "std_find", body.size(), [&]() {
+				keep(std::string_view(body).find(delimiter, 64));
+			});
+			for (int level = scan::SCALAR; level <= scan::bestLevel(); level++)
+			{
+				scan::setLevel(static_cast<scan::Level>(level));
+				runner.run("scan/boundary/" + label + scan::levelName(static_cast<scan::Level>(level)), body.size(), [&]() {
+					keep(scan::find(body, delimiter, 64));
+				});
+			}
+			scan::setLevel(scan::bestLevel());
+			// Includes parsing the parts and writing the file into a temporary directory
+			runner.run("handleMultipartUpload/" + std::to_string(options.multipartMb) + "mb", body.size(), [&]() {
+				keep(server.handleMultipartUpload(body, contentType, uploadDir.string()));
+			});
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "microbench: " << e.what() << std::endl;
+		status = 1;
+	}
+	std::filesystem::remove_all(uploadDir);
+	return status;
+}